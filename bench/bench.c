@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include "../src/warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * bench
+ * Generates a warehouse file and an art file, loads them into the database and runs a random mix of commands on it,
+ * timing every command. Each kind of command gets one line of results, as comma separated values:
+ *
+ * 	operation,count,seconds,ops_per_second,mean_us,p50_us,p99_us,max_us
+ *
+ * preceded by '#' lines describing the run, so the output of two builds can be compared line by line
+ * The database is linked in (built with -DART_DB_NO_MAIN) and driven through executeCommand(), with stdout silenced
+ *
+ * With -g the commands are written to a script for art_db -b instead, and the files are kept, e.g. as the training
+ * workload of the pgo target of the Makefile or to time different builds of art_db on the same commands
+ */
+
+/*
+ * rng
+ * xorshift64* generator, so a seed gives the same files and commands on every build
+ */
+static unsigned long long rngState = 88172645463325252ull;
+
+static unsigned long long nextRandom(){
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return rngState * 2685821657736338717ull;
+}
+
+static double nextUniform(){
+	return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * distribution
+ * Picks a rank in [0, count), either uniformly or with Zipf's law (rank k has weight 1/(k+1)^exponent), from its cumulative weights
+ */
+struct distribution {
+	int count;
+	double* cumulative; // NULL for uniform
+};
+
+static void initDistribution(struct distribution* distribution, int count, BOOLEAN zipf, double exponent){
+	distribution->count = count;
+	distribution->cumulative = NULL;
+	if (!zipf)
+		return;
+	distribution->cumulative = malloc(count * sizeof(double));
+	double total = 0;
+	int i;
+	for (i=0; i<count; i++){
+		total += 1.0 / pow(i + 1, exponent);
+		distribution->cumulative[i] = total;
+	}
+	for (i=0; i<count; i++)
+		distribution->cumulative[i] /= total;
+}
+
+static int sample(struct distribution* distribution){
+	if (!distribution->cumulative)
+		return nextRandom() % distribution->count;
+	double u = nextUniform();
+	int low = 0, high = distribution->count - 1;
+	while (low < high){
+		int middle = (low + high) / 2;
+		if (distribution->cumulative[middle] < u)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/*
+ * operation
+ * A kind of command of the mix, its weight in the mix, and the latencies of its runs
+ */
+enum { OP_ADD, OP_DELETE, OP_FIND, OP_PRINTALL, OP_PRINT_PUBLIC, OP_PRINT_SIZE, OP_PRINT_PRICE, OP_UTILIZATION, OP_LOAD_WAREHOUSE, OP_LOAD_ART, OP_COUNT };
+
+struct operation {
+	const char* name;
+	int weight;
+	double* latencies; // seconds
+	int count;
+	int capacity;
+};
+
+static struct operation operations[OP_COUNT] = {
+	{ "add", 500, NULL, 0, 0 },
+	{ "delete", 150, NULL, 0, 0 },
+	{ "find", 200, NULL, 0, 0 },
+	{ "printall", 1, NULL, 0, 0 },
+	{ "print_public", 1, NULL, 0, 0 },
+	{ "print_size", 1, NULL, 0, 0 },
+	{ "print_price", 1, NULL, 0, 0 },
+	{ "utilization", 146, NULL, 0, 0 },
+	{ "load_warehouse", 0, NULL, 0, 0 },
+	{ "load_art", 0, NULL, 0, 0 },
+};
+
+static void recordLatency(int op, struct timespec* start, struct timespec* end){
+	struct operation* operation = operations + op;
+	if (operation->count == operation->capacity){
+		operation->capacity = operation->capacity ? operation->capacity * 2 : 1024;
+		operation->latencies = realloc(operation->latencies, operation->capacity * sizeof(double));
+	}
+	operation->latencies[operation->count++] = (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int compareDoubles(const void* a, const void* b){
+	double first = *(const double*)a, second = *(const double*)b;
+	return (first > second) - (first < second);
+}
+
+/*
+ * parseMix()
+ * sets the weights of the mix from "name=weight,name=weight,...", operations not named getting a weight of 0
+ *
+ * Return:
+ * 	TRUE if every name was known
+ */
+static BOOLEAN parseMix(char* mix){
+	int op;
+	for (op=0; op<OP_COUNT; op++)
+		operations[op].weight = 0;
+	char* item;
+	for (item = strtok(mix, ","); item; item = strtok(NULL, ",")){
+		char* equalsSign = strchr(item, '=');
+		if (!equalsSign)
+			return FALSE;
+		*equalsSign = '\0';
+		for (op=0; op<OP_LOAD_WAREHOUSE && strcmp(operations[op].name, item); op++);
+		if (op == OP_LOAD_WAREHOUSE)
+			return FALSE;
+		operations[op].weight = atoi(equalsSign + 1);
+	}
+	return TRUE;
+}
+
+static FILE* script = NULL; // set by -g
+
+/*
+ * runCommand()
+ * executes a command the way the shell would (splitting a copy of it) and records its latency, or writes it to the script
+ */
+static void runCommand(int op, const char* command){
+	if (script){
+		fprintf(script, "%s\n", command);
+		return;
+	}
+	char line[512];
+	char* args[6];
+	snprintf(line, sizeof(line), "%s", command);
+	splitCommand(line, 5, args);
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	executeCommand(args);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	recordLatency(op, &start, &end);
+}
+
+/*
+ * runSortedPrint()
+ * prints by size or price directly, since which of the two printall does is fixed by -s at startup
+ */
+static void runSortedPrint(int op){
+	if (script){
+		fprintf(script, "printall\n"); // a script can't choose, so it prints in the order art_db -s was given
+		return;
+	}
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (op == OP_PRINT_SIZE)
+		printBySize(1, 1);
+	else
+		printByPrice(1, 1);
+	flushOutput();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	recordLatency(op, &start, &end);
+}
+
+static void usage(){
+	fprintf(stderr, "usage: art_db_bench [-w warehouses] [-a art] [-n commands] [-d uniform|zipf] [-z exponent] [-p private_fraction]\n"
+		"\t[-N names] [-m add=500,delete=150,find=200,printall=1,print_public=1,print_size=1,print_price=1,utilization=146]\n"
+		"\t[-S seed] [-t loader_threads] [-v] [-k directory] [-o output | -g script]\n");
+	exit(1);
+}
+
+int main(int argc, char** argv){
+	int warehouseCount = 20000;
+	int artCount = 40000;
+	int commandCount = 20000;
+	int nameCount = 2000;
+	BOOLEAN zipf = FALSE;
+	double exponent = 1.1;
+	double privateFraction = 0.5;
+	unsigned long long seed = 1;
+	const char* directory = "/tmp";
+	const char* outputName = NULL;
+	char mixDescription[256] = "";
+	int opt;
+	while ((opt = getopt(argc, argv, "w:a:n:d:z:p:N:m:S:t:vk:o:g:")) != -1){
+		switch (opt){
+			case 'w': warehouseCount = atoi(optarg); break;
+			case 'a': artCount = atoi(optarg); break;
+			case 'n': commandCount = atoi(optarg); break;
+			case 'd':
+				if (!strcmp(optarg, "zipf"))
+					zipf = TRUE;
+				else if (strcmp(optarg, "uniform"))
+					usage();
+				break;
+			case 'z': exponent = atof(optarg); break;
+			case 'p': privateFraction = atof(optarg); break;
+			case 'N': nameCount = atoi(optarg); break;
+			case 'm':
+				snprintf(mixDescription, sizeof(mixDescription), "%s", optarg);
+				if (!parseMix(optarg))
+					usage();
+				break;
+			case 'S': seed = strtoull(optarg, NULL, 10); break;
+			case 't': setLoaderThreads(atoi(optarg)); break;
+			case 'v': setSortedViews(TRUE); break;
+			case 'k': directory = optarg; break;
+			case 'o': outputName = optarg; break;
+			case 'g':
+				script = fopen(optarg, "w");
+				if (!script){
+					fprintf(stderr, "failed to write %s\n", optarg);
+					return 1;
+				}
+				break;
+			default: usage();
+		}
+	}
+	if (warehouseCount < 1 || artCount < 0 || commandCount < 0 || nameCount < 1)
+		usage();
+	rngState ^= seed * 0x9E3779B97F4A7C15ull;
+	int totalWeight = 0;
+	int op;
+	for (op=0; op<OP_LOAD_WAREHOUSE; op++)
+		totalWeight += operations[op].weight;
+
+	// warehouse sizes are even, from 4 to 256; art sizes from 1 to 128, so most fit and some splits are needed
+	struct distribution warehouseSizes, artSizes, names;
+	initDistribution(&warehouseSizes, 127, zipf, exponent);
+	initDistribution(&artSizes, 128, zipf, exponent);
+	initDistribution(&names, nameCount, zipf, exponent);
+
+	char warehouseName[1024], artName[1024];
+	snprintf(warehouseName, sizeof(warehouseName), "%s/art_db_bench_warehouses.txt", directory);
+	snprintf(artName, sizeof(artName), "%s/art_db_bench_art.txt", directory);
+	FILE* file = fopen(warehouseName, "w");
+	if (!file){
+		fprintf(stderr, "failed to write %s\n", warehouseName);
+		return 1;
+	}
+	int i;
+	for (i=0; i<warehouseCount; i++)
+		fprintf(file, "%d %d %d\n", i + 1, 4 + 2 * sample(&warehouseSizes), nextUniform() < privateFraction);
+	fclose(file);
+	file = fopen(artName, "w");
+	if (!file){
+		fprintf(stderr, "failed to write %s\n", artName);
+		return 1;
+	}
+	for (i=0; i<artCount; i++)
+		fprintf(file, "art%d %d %d\n", sample(&names), 1 + sample(&artSizes), (int)(nextRandom() % 10000));
+	fclose(file);
+
+	int output = script ? -1 : silenceOutput();
+	char command[1200];
+	snprintf(command, sizeof(command), "load warehouse \"%s\"", warehouseName);
+	runCommand(OP_LOAD_WAREHOUSE, command);
+	snprintf(command, sizeof(command), "load art \"%s\"", artName);
+	runCommand(OP_LOAD_ART, command);
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i=0; i<commandCount && totalWeight; i++){
+		int pick = nextRandom() % totalWeight;
+		for (op=0; pick >= operations[op].weight; op++)
+			pick -= operations[op].weight;
+		switch (op){
+			case OP_ADD:
+				snprintf(command, sizeof(command), "add art \"art%d\" %d %d", sample(&names), 1 + sample(&artSizes), (int)(nextRandom() % 10000));
+				runCommand(op, command);
+				break;
+			case OP_DELETE:
+				snprintf(command, sizeof(command), "delete art \"art%d\"", sample(&names));
+				runCommand(op, command);
+				break;
+			case OP_FIND:
+				snprintf(command, sizeof(command), "find art \"art%d\"", sample(&names));
+				runCommand(op, command);
+				break;
+			case OP_PRINTALL:
+				runCommand(op, "printall");
+				break;
+			case OP_PRINT_PUBLIC:
+				runCommand(op, "print public");
+				break;
+			case OP_PRINT_SIZE:
+			case OP_PRINT_PRICE:
+				runSortedPrint(op);
+				break;
+			case OP_UTILIZATION:
+				runCommand(op, "utilization");
+				break;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (script){
+		fprintf(script, "exit\n");
+		fclose(script);
+		return 0;
+	}
+	double occupied, filled;
+	getUtilization(TRUE, TRUE, &occupied, &filled);
+	restoreOutput(output);
+	freeAllWarehouseSFList();
+	remove(warehouseName);
+	remove(artName);
+
+	FILE* results = stdout;
+	if (outputName && !(results = fopen(outputName, "w"))){
+		fprintf(stderr, "failed to write %s\n", outputName);
+		return 1;
+	}
+	fprintf(results, "# warehouses=%d art=%d commands=%d names=%d distribution=%s exponent=%g private=%g seed=%llu views=%s\n",
+		warehouseCount, artCount, commandCount, nameCount, zipf ? "zipf" : "uniform", exponent, privateFraction, seed,
+		sortedViewsEnabled() ? "on" : "off");
+	if (*mixDescription)
+		fprintf(results, "# mix=%s\n", mixDescription);
+	fprintf(results, "# mix_seconds=%f final_occupied=%f final_filled=%f\n",
+		(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9, occupied, filled);
+	fprintf(results, "operation,count,seconds,ops_per_second,mean_us,p50_us,p99_us,max_us\n");
+	for (op=0; op<OP_COUNT; op++){
+		struct operation* operation = operations + op;
+		if (!operation->count)
+			continue;
+		double total = 0;
+		for (i=0; i<operation->count; i++)
+			total += operation->latencies[i];
+		qsort(operation->latencies, operation->count, sizeof(double), compareDoubles);
+		double p50 = operation->latencies[(operation->count - 1) / 2];
+		double p99 = operation->latencies[(int)((operation->count - 1) * 0.99)];
+		fprintf(results, "%s,%d,%f,%.1f,%.2f,%.2f,%.2f,%.2f\n", operation->name, operation->count, total,
+			total > 0 ? operation->count / total : 0, total / operation->count * 1e6, p50 * 1e6, p99 * 1e6,
+			operation->latencies[operation->count - 1] * 1e6);
+		free(operation->latencies);
+	}
+	if (results != stdout)
+		fclose(results);
+	return 0;
+}
@@ -0,0 +1,121 @@
+#!/bin/bash
+# regress.sh
+# Regression checks of art_db, run by the check target of the Makefile on a small workload written by art_db_bench -g:
+#
+# 	views     the output of every print order is the same with the sorted views on, off, and turned on halfway
+# 	snapshot  restoring a save made halfway gives the same output for the rest of the commands as carrying on after the save
+# 	journal   a journaled session killed with SIGKILL (with and without a compact in it) recovers to the same output as a
+# 	          session that was never interrupted
+# 	baseline  given the art_db of the first commit, the shell and quiet mode print exactly what it prints, with the views
+# 	          off and on and with no merges of free space (-d 0), on a workload of the commands it has and gets right:
+# 	          it has no find, it coalesces differently (losing the merged warehouse), and its print public|private
+# 	          prints nothing in price order, so these are left out. It also loops forever inserting a class after the
+# 	          smallest one and reads freed nodes in its sorted prints, so it gets the warehouses largest first and
+# 	          runs without the tcache of glibc, which would overwrite those nodes
+#
+# Prints a line per check and exits with the number of checks that failed
+#
+# usage: bench/regress.sh [art_db] [art_db_bench] [baseline art_db]
+
+ART_DB=${1:-./art_db}
+BENCH=${2:-./art_db_bench}
+BASELINE=$3
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+failed=0
+
+# check name file1 file2
+check(){
+	if [ -s "$2" ] && cmp -s "$2" "$3"; then
+		echo "ok     $1"
+	else
+		echo "FAILED $1"
+		failed=$((failed + 1))
+	fi
+}
+
+# an unknown command, whose error separates the part of a run before it from the part being compared
+MARKER=regress-marker
+afterMarker(){
+	awk 'found { print } /not a valid command/ && !found { found = 1 }'
+}
+
+"$BENCH" -w 2000 -a 4000 -n 4000 -S 7 -p 0.3 \
+	-m add=500,delete=150,find=200,printall=20,print_public=10,print_size=20,print_price=20,utilization=80 \
+	-k "$DIR" -g "$DIR/script.txt" > /dev/null || exit 1
+grep -v '^exit$' "$DIR/script.txt" > "$DIR/commands.txt"
+half=$(($(wc -l < "$DIR/commands.txt") / 2))
+head -n $half "$DIR/commands.txt" > "$DIR/first.txt"
+tail -n +$((half + 1)) "$DIR/commands.txt" > "$DIR/rest.txt"
+
+for order in "" "-s s" "-s p"; do
+	name="views${order:+ $order}"
+	"$ART_DB" $order -v -b "$DIR/commands.txt" > "$DIR/on.out" 2> /dev/null
+	"$ART_DB" $order -b "$DIR/commands.txt" > "$DIR/off.out" 2> /dev/null
+	{ cat "$DIR/first.txt"; echo "views on"; cat "$DIR/rest.txt"; } |
+		"$ART_DB" $order -b - > "$DIR/rebuilt.out" 2> /dev/null
+	check "$name off" "$DIR/on.out" "$DIR/off.out"
+	check "$name rebuilt" "$DIR/on.out" "$DIR/rebuilt.out"
+done
+
+for order in "" "-s s" "-s p"; do
+	rm -f "$DIR/snapshot"
+	{ cat "$DIR/first.txt"; echo "save \"$DIR/snapshot\""; echo $MARKER; cat "$DIR/rest.txt"; } |
+		"$ART_DB" $order -b - 2> /dev/null | afterMarker > "$DIR/saved.out"
+	{ echo $MARKER; cat "$DIR/rest.txt"; } |
+		"$ART_DB" $order -r "$DIR/snapshot" -b - 2> /dev/null | afterMarker > "$DIR/restored.out"
+	check "snapshot${order:+ $order}" "$DIR/saved.out" "$DIR/restored.out"
+done
+
+{ cat "$DIR/first.txt"; echo $MARKER; cat "$DIR/rest.txt"; } |
+	"$ART_DB" -b - 2> /dev/null | afterMarker > "$DIR/uninterrupted.out"
+for compact in 0 1; do
+	rm -f "$DIR/journal" "$DIR/journal".*
+	mkfifo "$DIR/input"
+	"$ART_DB" -j "$DIR/journal" < "$DIR/input" > "$DIR/killed.out" 2> /dev/null &
+	pid=$!
+	exec 3> "$DIR/input"
+	awk -v half=$((half / 2)) -v compact=$compact 'NR == half && compact { print "compact" } { print }' "$DIR/first.txt" >&3
+	# the journal is synced before each line is read, so once the second marker has been answered everything before it is on disk
+	echo $MARKER >&3
+	echo $MARKER >&3
+	for wait in $(seq 300); do
+		[ "$(grep -c 'not a valid command' "$DIR/killed.out")" -ge 2 ] && break
+		sleep 0.1
+	done
+	kill -9 $pid
+	wait $pid 2> /dev/null
+	exec 3>&-
+	rm -f "$DIR/input"
+	{ echo $MARKER; cat "$DIR/rest.txt"; } |
+		"$ART_DB" -j "$DIR/journal" -b - 2> /dev/null | afterMarker > "$DIR/recovered.out"
+	check "journal$([ $compact = 1 ] && echo ' with compact')" "$DIR/uninterrupted.out" "$DIR/recovered.out"
+done
+
+if [ -n "$BASELINE" ]; then
+	mkdir "$DIR/baseline"
+	"$BENCH" -w 400 -a 800 -n 1500 -S 7 -p 0.3 -m add=500,printall=20,print_public=10,print_size=20,print_price=20,utilization=80 \
+		-k "$DIR/baseline" -g "$DIR/baseline/script.txt" > /dev/null || exit 1
+	sort -s -k2,2nr "$DIR/baseline/art_db_bench_warehouses.txt" > "$DIR/baseline/warehouses.txt"
+	sed 's|art_db_bench_warehouses.txt|warehouses.txt|' "$DIR/baseline/script.txt" > "$DIR/baseline/commands.txt"
+	for order in "" "-s s" "-s p"; do
+		commands="$DIR/baseline/commands.txt"
+		if [ "$order" = "-s p" ]; then
+			grep -v '^print p' "$commands" > "$DIR/baseline/price.txt"
+			commands="$DIR/baseline/price.txt"
+		fi
+		GLIBC_TUNABLES=glibc.malloc.tcache_count=0 "$BASELINE" $order < "$commands" > "$DIR/expected.out" 2>&1
+		GLIBC_TUNABLES=glibc.malloc.tcache_count=0 "$BASELINE" -q $order -w "$DIR/baseline/warehouses.txt" \
+			-a "$DIR/baseline/art_db_bench_art.txt" > "$DIR/expected_quiet.out" 2>&1
+		for views in "" "-v"; do
+			name="baseline${order:+ $order}${views:+ $views}"
+			"$ART_DB" $order $views -d 0 < "$commands" > "$DIR/shell.out" 2>&1
+			"$ART_DB" -q $order $views -d 0 -w "$DIR/baseline/warehouses.txt" \
+				-a "$DIR/baseline/art_db_bench_art.txt" > "$DIR/quiet.out" 2>&1
+			check "$name" "$DIR/expected.out" "$DIR/shell.out"
+			check "$name -q" "$DIR/expected_quiet.out" "$DIR/quiet.out"
+		done
+	done
+fi
+
+exit $failed
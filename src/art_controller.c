@@ -2,15 +2,19 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdint.h>
 #include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
 
 /*
  * createArtCollection()
- * allocates memory for an art collection with a specified name, size, price
+ * allocates an art collection with a specified name, size, price from its pool
  *
  * Params:
  * 	name
- * 	string for the name of the art collection which will be copied to a new location and pointed to by the new art collection
+ * 	string for the name of the art collection, whose lowercase version is interned in the string table and pointed to by the new art collection
  *
  * 	size
  * 	value for the smallest size warehouse that can fit this art collection
@@ -19,177 +23,232 @@
  * 	value to measure worth of art collection
  *
  * Return:
- * 	pointer to newly malloc'd art collection struct
+ * 	pointer to the new art collection struct
  */
 struct art_collection* createArtCollection(char* name, int size, int price){
-	struct art_collection* output = malloc(sizeof(struct art_collection));
-	output->name = malloc(strlen(name)+1);
-	strcpy(output->name, name);
-	int i;
-	for (i=0; i<strlen(output->name); i++)
-		(output->name)[i] = tolower((output->name)[i]);
+	return createArtCollectionFromName(name, strlen(name), size, price);
+}
+
+/*
+ * createArtCollectionFromName()
+ * allocates an art collection from its pool with a name that need not be NUL terminated (e.g. a field of a mapped file)
+ *
+ * Params:
+ * 	name, length
+ * 	the characters of the name, whose lowercase version is interned in the string table
+ *
+ * 	size, price
+ * 	as for createArtCollection()
+ *
+ * Return:
+ * 	pointer to the new art collection struct
+ */
+struct art_collection* createArtCollectionFromName(const char* name, size_t length, int size, int price){
+	struct art_collection* output = poolAlloc(&artCollectionPool);
+	output->name = internLowercase(name, length);
 	output->size = size;
 	output->price = price;
 	return output;
 }
 
 /*
- * insertArtCollection
- * finds an empty, sizable warehouse to store the specified art collection, or reports the failure to the user
+ * freeArtCollection()
+ * gives an art collection back to its pool (its name stays interned)
  *
  * Params:
  * 	art_collection
- * 	art collection to be stored
+ * 	the art collection to be freed
  *
  * Return:
  * 	void
  */
-void insertArtCollection(struct art_collection* art_collection){
+void freeArtCollection(struct art_collection* art_collection){
+	poolFree(&artCollectionPool, art_collection);
+}
+
+/*
+ * carveWarehouse()
+ * stores an art collection in an unoccupied warehouse large enough for it, first splitting the warehouse if at least 4 would be left
+ * the art collection takes the first half of a split, which is cut to its (even) size and so is always the best fit
+ *
+ * Params:
+ * 	sf
+ * 	the class of the warehouse
+ *
+ * 	wl
+ * 	the unoccupied warehouse
+ *
+ * 	art_collection
+ * 	art collection to be stored
+ *
+ * Return:
+ * 	the half left unoccupied by the split, NULL if the warehouse was filled whole
+ */
+static struct warehouse_list* carveWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl, struct art_collection* art_collection){
+	int artSize = art_collection->size;
+	if (art_collection->size % 2)
+		artSize++;
+	if (artSize < 4)
+		artSize = 4;
+	if (sf->class_size - artSize < 4){
+		fillWarehouse(sf, wl, art_collection);
+		return NULL;
+	}
+	struct warehouse_split* split = splitWarehouse(sf, wl, artSize);
+	fillWarehouse(findSFList(artSize), split->halves[0], art_collection);
+	return split->halves[1];
+}
+
+/*
+ * placeArtCollection()
+ * finds an empty, sizable warehouse to store the specified art collection, or reports the failure to the user (and to defrag.c)
+ * the size directory gives the smallest class with an unoccupied warehouse, and that class's free bitmap gives the warehouse
+ *
+ * Params:
+ * 	art_collection
+ * 	art collection to be stored
+ *
+ * 	leftover
+ * 	set to the half of the warehouse left unoccupied if it had to be split, NULL otherwise
+ *
+ * Return:
+ * 	TRUE if the art collection was stored
+ */
+static BOOLEAN placeArtCollection(struct art_collection* art_collection, struct warehouse_list** leftover){
+	*leftover = NULL;
 	if (!sf_head){
-		printf("ERROR: There exist no warehouse in the database!\n");
-		if (art_collection->name)
-			free(art_collection->name);
-		free(art_collection);
-		return;
+		printError("There exist no warehouse in the database!\n");
+		freeArtCollection(art_collection);
+		return FALSE;
 	}
-	struct warehouse_sf_list* sf_cursor = sf_head;
-	while (sf_cursor->class_size < art_collection->size){
-		sf_cursor = sf_cursor->sf_next_warehouse;
-		if (!sf_cursor){
-			printf("ERROR: There exists no unoccupied warehouse large enough to fit Art Collection \"%s\".\n", art_collection->name);
-			if (art_collection->name)
-				free(art_collection->name);
-			free(art_collection);
-			return;
-		}
+	struct warehouse_sf_list* sf_cursor;
+	struct warehouse_list* wl_cursor = findFreeWarehouse(art_collection->size, &sf_cursor);
+	if (!sf_cursor){
+		printError("There exists no unoccupied warehouse large enough to fit Art Collection \"%s\".\n", art_collection->name);
+		defragDemand(art_collection->size);
+		freeArtCollection(art_collection);
+		return FALSE;
 	}
-	struct warehouse_list* wl_cursor = sf_cursor->warehouse_list_head;
-	struct warehouse_list* wl_prev = NULL;
-	while (1){
-		while (!wl_cursor){
-			sf_cursor = sf_cursor->sf_next_warehouse;
-			if (!sf_cursor){
-				printf("ERROR: There exists no Warehouse large enough to fit Art Collection \"%s\".\n", art_collection->name);
-				if (art_collection->name)
-					free(art_collection->name);
-				free(art_collection);
-				return;
-			}
-			wl_cursor = sf_cursor->warehouse_list_head;
-			wl_prev = NULL;
-		}
-		while(wl_cursor){
-			if ((wl_cursor->meta_info) & 2){
-				wl_prev = wl_cursor;
-				wl_cursor = wl_cursor->next_warehouse;
-			}
-			else{
-				int artSize = art_collection->size;
-				if (art_collection->size % 2)
-					artSize++;
-				if (artSize < 4)
-					artSize = 4;
-				int newSize = sf_cursor->class_size - artSize;
-				if (newSize < 4){
-					wl_cursor->warehouse->art_collection = art_collection;
-					wl_cursor->meta_info = wl_cursor->meta_info | 2;
-					return;
-				}
-				else{
-					if (wl_prev)
-						wl_prev->next_warehouse = wl_cursor->next_warehouse;
-					else 
-						sf_cursor->warehouse_list_head = wl_cursor->next_warehouse;
-					insertWarehouse(createWarehouse(	wl_cursor->warehouse->id, 	artSize),	wl_cursor->meta_info&1);
-					insertWarehouse(createWarehouse(	nextGoodID(),			newSize),	wl_cursor->meta_info&1);
-					freeWarehouseList(wl_cursor);
-					insertArtCollection(art_collection);
-					return;
-				}
-			}
-		}
+	if (!wl_cursor){
+		printError("There exists no Warehouse large enough to fit Art Collection \"%s\".\n", art_collection->name);
+		defragDemand(art_collection->size);
+		freeArtCollection(art_collection);
+		return FALSE;
 	}
+	*leftover = carveWarehouse(sf_cursor, wl_cursor, art_collection);
+	return TRUE;
 }
 
-extern BOOLEAN equals(char* s1, char* s2); //used in removeArtCollection defined in main.c
+/*
+ * insertArtCollection()
+ * stores an art collection with placeArtCollection(), timing the whole placement (splits included) as one call
+ *
+ * Params:
+ * 	art_collection
+ * 	art collection to be stored
+ *
+ * Return:
+ * 	TRUE if the art collection was stored
+ */
+BOOLEAN insertArtCollection(struct art_collection* art_collection){
+	STATS_START(timer);
+	struct warehouse_list* leftover;
+	BOOLEAN stored = placeArtCollection(art_collection, &leftover);
+	STATS_STOP(timer, STAT_INSERT_ART_COLLECTION);
+	return stored;
+}
+
+/*
+ * insertArtCollectionRun()
+ * stores art collections of the same size one after the other, splitting them in bulk out of the warehouse the first one was placed in
+ * that warehouse was the smallest unoccupied one that fit, so no unoccupied warehouse is between their size and its size but what
+ * its splits leave: each next one is carved straight out of that leftover while it fits, without searching the size directory again
+ * the warehouses (and their IDs) end up as if each art collection had been stored by insertArtCollection() in turn
+ *
+ * Params:
+ * 	art_collections, count
+ * 	the art collections to be stored, all of the same size
+ *
+ * Return:
+ * 	number of art collections that were stored
+ */
+int insertArtCollectionRun(struct art_collection** art_collections, int count){
+	struct warehouse_list* leftover = NULL;
+	int stored = 0;
+	int i;
+	for (i=0; i<count; i++){
+		STATS_START(timer);
+		if (leftover && leftover->warehouse->size >= art_collections[i]->size){
+			leftover = carveWarehouse(findSFList(leftover->warehouse->size), leftover, art_collections[i]);
+			stored++;
+		}
+		else
+			stored += placeArtCollection(art_collections[i], &leftover);
+		STATS_STOP(timer, STAT_INSERT_ART_COLLECTION);
+	}
+	return stored;
+}
 
 /*
  * removeArtCollection()
  * removes all instances of an art collection from the database
+ * the matches come from the name index in the order a walk of the database would meet them, and are emptied (and coalesced) in that order
+ * emptying only ever frees unoccupied warehouses, so the matches gathered stay valid until their turn
  *
  * Params:
  * 	name
  * 	name to be removed if matching
  *
- * 	count
- * 	variable to keep track of total matching names found, used in recursion, should always be 0 otherwise
- *
  * Return: 
  * 	void
  */
-void removeArtCollection(char* name, int count){
-	struct warehouse_sf_list* sf_cursor = sf_head;
-	struct warehouse_list* wl_cursor;
-	struct warehouse_list* wl_prev;
-	struct warehouse_list* wl_prev_prev;
-	while (sf_cursor){
-		wl_prev_prev = NULL;
-		wl_prev = NULL;
-		wl_cursor = sf_cursor->warehouse_list_head;
-		while (wl_cursor){
-			if ((wl_cursor->meta_info & 2) && (equals(wl_cursor->warehouse->art_collection->name, name))){
-				emptyWarehouse(sf_cursor, wl_prev_prev, wl_prev, wl_cursor);
-				removeArtCollection(name, ++count);
-				return;
-			}
-			wl_prev_prev = wl_prev;
-			wl_prev = wl_cursor;
-			//long int size = (wl_cursor->meta_info & -4) >> 1;
-			//printf("\twarehouse %d\n\t\tof size %ld\n\t\t%s with %s in it\n", wl_cursor->warehouse->id, size, (wl_cursor->meta_info & 1)?"Private":"Public", (wl_cursor->meta_info & 2)? wl_cursor->warehouse->art_collection->name : "nothing");
-			wl_cursor = wl_cursor->next_warehouse;
-		}
-		sf_cursor = sf_cursor->sf_next_warehouse;
-	}
+void removeArtCollection(char* name){
+	int count;
+	struct warehouse_list** matches = gatherArtCollections(name, &count);
+	int i;
+	for (i=0; i<count; i++)
+		emptyWarehouse(findSFList(matches[i]->warehouse->size), matches[i]);
+	free(matches);
 	if (count)
-		printf("%d instance%s of %s found and deleted.\n", count, (count==1) ? "" : "s", name);
+		outputFormat("%d instance%s of %s found and deleted.\n", count, (count==1) ? "" : "s", name);
 	else
-		printf("No instances of %s found, nothing deleted.\n", name);
+		outputFormat("No instances of %s found, nothing deleted.\n", name);
 }
 
 /*
- * loadArtFile()
- * creates and inserts art collections from file each specified by NAME SIZE PRICE\n
+ * findArtCollection()
+ * prints the info of all instances of an art collection to stdout, followed by their total price
  *
  * Params:
- * 	artFile
- * 	pointer to the opened file to be read
+ * 	name
+ * 	name to be printed if matching
  *
  * Return:
  * 	void
  */
-void loadArtFile(FILE* artFile){
-	char* commandLine = malloc(256 * sizeof(char*));
-	char** args;
-	char* name;
-	int size;
-	int price;
-	while (fgets(commandLine, 255, artFile) != NULL){
-		args = commandSplitter(commandLine, 3);
-		if (args && (args+1) && (args+2)){
-			name = *args;
-			size = atoi(*(args+1));
-			price = atoi(*(args+2));
-			insertArtCollection( createArtCollection(name, size, price));
-		}
-		if (args)
-			free(args);
+void findArtCollection(char* name){
+	int count;
+	struct warehouse_list** matches = gatherArtCollections(name, &count);
+	int total = 0;
+	int i;
+	if (!count){
+		outputString("No instances of ");
+		outputString(name);
+		outputString(" found.\n");
+		return;
+	}
+	for (i=0; i<count; i++){
+		printArtCollection(matches[i]->warehouse->art_collection);
+		total += matches[i]->warehouse->art_collection->price;
 	}
-	free(commandLine);
+	free(matches);
+	outputInt(total);
+	outputBytes("\n", 1);
 }
 
 /*
  * printArtCollection()
- * prints the info of the specified art collection to stdout
+ * prints the info of the specified art collection to stdout (or the file output is redirected to), through the buffer of output.c
  *
  * Params:
  * 	artC
@@ -199,12 +258,18 @@ void loadArtFile(FILE* artFile){
  * 	void
  */
 void printArtCollection(struct art_collection* artC){
-	printf("%s %d %d\n", artC->name, artC->size,  artC->price);
+	outputString(artC->name);
+	outputBytes(" ", 1);
+	outputInt(artC->size);
+	outputBytes(" ", 1);
+	outputInt(artC->price);
+	outputBytes("\n", 1);
 }
 
 /*
  * printUnsorted()
  * prints the info of all art collections of the database to stdout
+ * each class is read sequentially, its occupied slots of the visibility asked for picked from its bitmaps and their art collections from its array
  *
  * Params:
  * 	all
@@ -219,58 +284,85 @@ void printArtCollection(struct art_collection* artC){
  * 	void
  */
 void printUnsorted(BOOLEAN all, BOOLEAN private){
+	STATS_START(timer);
 	struct warehouse_sf_list* sf_cursor = sf_head;
-	struct warehouse_list* wl_cursor;
 	int total = 0;
 	while (sf_cursor){
-		wl_cursor = sf_cursor->warehouse_list_head;
-		while(wl_cursor){
-			if (((wl_cursor->meta_info) & 2) && (all  || !((wl_cursor->meta_info & 1) ^ private))){
-				printArtCollection( wl_cursor->warehouse->art_collection);
-				total += wl_cursor->warehouse->art_collection->price;
+		uint32_t word;
+		for (word=0; word<(sf_cursor->slot_count + 63) / 64; word++){
+			uint64_t bits = occupiedSlots(sf_cursor, word, all, private);
+			while (bits){
+				struct art_collection* artC = sf_cursor->arts[(word << 6) + __builtin_ctzll(bits)];
+				STATS_COUNT(STAT_NODES_TRAVERSED, 1);
+				printArtCollection(artC);
+				total += artC->price;
+				bits &= bits - 1;
 			}
-			wl_cursor = wl_cursor->next_warehouse;
 		}
 		sf_cursor = sf_cursor->sf_next_warehouse;
 	}
-	printf("%d\n", total);
+	outputInt(total);
+	outputBytes("\n", 1);
+	STATS_STOP(timer, STAT_PRINT_UNSORTED);
 }
 
 /*
- * art_collection_list
- * Data Structure to help sort art collections for printing
+ * sorted_art_collection
+ * An art collection paired with the key it is sorted by, biased so the unsigned order of key matches the signed order of the int
  */
-struct art_collection_list{
+struct sorted_art_collection{
+	uint32_t key;
 	struct art_collection* art_collection;
-	struct art_collection_list* next;
 };
 
 /*
- * printAndFreeACL()
- * once the art collection list is made and sorted, this function prints all of them and frees the art collection list wrapper (not the art collection itself)
+ * radixSortArtCollections()
+ * stable LSD radix sort of the gathered art collections by key, one pass per byte of the key
+ * passes where every key has the same byte are skipped, which is most of them for small sizes and prices
  *
  * Params:
- * 	acl_cursor
- * 	head of the art collection list
+ * 	items
+ * 	the art collections to be sorted, in the order ties must keep
+ *
+ * 	scratch
+ * 	buffer of at least count elements used between passes
+ *
+ * 	count
+ * 	number of art collections
  *
  * Return:
- * 	void
+ * 	items or scratch, whichever holds the sorted result
  */
-void printAndFreeACL(struct art_collection_list* acl_cursor){
-	struct art_collection_list* acl_prev;
-	int total = 0;
-	while (acl_cursor){
-		printArtCollection(acl_cursor->art_collection);
-		acl_prev = acl_cursor;
-		free(acl_prev);
-		acl_cursor = acl_cursor->next;
+static struct sorted_art_collection* radixSortArtCollections(struct sorted_art_collection* items, struct sorted_art_collection* scratch, int count){
+	int shift;
+	for (shift=0; shift<32; shift+=8){
+		int buckets[256] = {0};
+		int i;
+		for (i=0; i<count; i++)
+			buckets[(items[i].key >> shift) & 0xff]++;
+		if (buckets[(items[0].key >> shift) & 0xff] == count)
+			continue;
+		int offset = 0;
+		for (i=0; i<256; i++){
+			int bucketCount = buckets[i];
+			buckets[i] = offset;
+			offset += bucketCount;
+		}
+		for (i=0; i<count; i++)
+			scratch[buckets[(items[i].key >> shift) & 0xff]++] = items[i];
+		struct sorted_art_collection* temp = items;
+		items = scratch;
+		scratch = temp;
 	}
-	printf("%d\n", total);
+	return items;
 }
 
 /*
- * printBySize()
- * creates the acl data structure sorted by size and calls printAndFreeACL()
+ * printSorted()
+ * prints the art collections by walking the sorted views if they are enabled
+ * otherwise gathers the art collections to be printed into an array in database order, sorts them by size or price and prints them
+ * the sort is stable, so collections of the same key are printed in the order printUnsorted() would print them
+ * unlike printUnsorted(), the sorted prints have always ended with a total of 0 (it was never summed), and still do
  *
  * Params:
  * 	all
@@ -281,65 +373,77 @@ void printAndFreeACL(struct art_collection_list* acl_cursor){
  * 	FALSE if art collections in public warehouses are to be printed
  * 	overridden by all param
  *
+ * 	bySize
+ * 	TRUE to sort by size, FALSE to sort by price
+ *
  * Return:
  * 	void
  */
-void printBySize(BOOLEAN all, BOOLEAN private){
+static void printSorted(BOOLEAN all, BOOLEAN private, BOOLEAN bySize){
+	if (sortedViewsEnabled()){
+		printSortedView(all, private, bySize);
+		return;
+	}
 	struct warehouse_sf_list* sf_cursor = sf_head;
-	struct warehouse_list* wl_cursor;
-	struct art_collection_list* acl_head = NULL;
-	struct art_collection_list* acl_cursor = NULL;
-	struct art_collection_list* acl_prev;
-	struct art_collection_list* acl_new;
+	struct sorted_art_collection* items = NULL;
+	int count = 0;
+	int capacity = 0;
 	while (sf_cursor){
-		wl_cursor = sf_cursor->warehouse_list_head;
-		while(wl_cursor){
-			if (((wl_cursor->meta_info) & 2) && (all || !((wl_cursor->meta_info & 1) ^ private))){
-				if (acl_head){
-					if (acl_head->art_collection->size > wl_cursor->warehouse->art_collection->size){
-						acl_new = malloc(sizeof(struct art_collection_list));
-						acl_new->art_collection = wl_cursor->warehouse->art_collection;
-						acl_new->next = acl_head;
-						acl_head = acl_new;
-					}
-					else{
-						acl_cursor = acl_head->next;
-						acl_prev = acl_head;
-						while (acl_cursor){
-							if (acl_cursor->art_collection->size > wl_cursor->warehouse->art_collection->size){
-								acl_new = malloc(sizeof(struct art_collection_list));
-								acl_new->art_collection = wl_cursor->warehouse->art_collection;
-								acl_new->next = acl_cursor;
-								acl_prev->next = acl_new;
-								break;
-							}
-							acl_prev = acl_cursor;
-							acl_cursor = acl_cursor->next;
-						}
-						if (!acl_cursor){ 
-							acl_new = malloc(sizeof(struct art_collection_list));
-							acl_new->art_collection = wl_cursor->warehouse->art_collection;
-							acl_new->next = NULL;
-							acl_prev->next = acl_new;
-						}
-					}
-				}
-				else{
-					acl_head = malloc(sizeof(struct art_collection_list));
-					acl_head->art_collection = wl_cursor->warehouse->art_collection;
-					acl_head->next = NULL;
+		uint32_t word;
+		for (word=0; word<(sf_cursor->slot_count + 63) / 64; word++){
+			uint64_t bits = occupiedSlots(sf_cursor, word, all, private);
+			while (bits){
+				struct art_collection* artC = sf_cursor->arts[(word << 6) + __builtin_ctzll(bits)];
+				STATS_COUNT(STAT_NODES_TRAVERSED, 1);
+				if (count == capacity){
+					capacity = capacity ? capacity * 2 : 64;
+					items = realloc(items, capacity * sizeof(struct sorted_art_collection));
 				}
+				items[count].key = (uint32_t)(bySize ? artC->size : artC->price) ^ 0x80000000u;
+				items[count].art_collection = artC;
+				count++;
+				bits &= bits - 1;
 			}
-		wl_cursor = wl_cursor->next_warehouse;
 		}
-	sf_cursor = sf_cursor->sf_next_warehouse;
+		sf_cursor = sf_cursor->sf_next_warehouse;
 	}
-	printAndFreeACL(acl_head);
+	if (count){
+		struct sorted_art_collection* scratch = malloc(count * sizeof(struct sorted_art_collection));
+		struct sorted_art_collection* sorted = radixSortArtCollections(items, scratch, count);
+		int i;
+		for (i=0; i<count; i++)
+			printArtCollection(sorted[i].art_collection);
+		free(scratch);
+	}
+	free(items);
+	outputBytes("0\n", 2);
+}
+
+/*
+ * printBySize()
+ * prints the info of the art collections of the database to stdout, sorted by size
+ *
+ * Params:
+ * 	all
+ * 	TRUE if all art collections are to be printed,  FALSE otherwise
+ *
+ * 	private
+ * 	TRUE if art collections in private warehouses are to be printed
+ * 	FALSE if art collections in public warehouses are to be printed
+ * 	overridden by all param
+ *
+ * Return:
+ * 	void
+ */
+void printBySize(BOOLEAN all, BOOLEAN private){
+	STATS_START(timer);
+	printSorted(all, private, TRUE);
+	STATS_STOP(timer, STAT_PRINT_BY_SIZE);
 }
 
 /*
  * printByPrice()
- * creates the acl data structure sorted by price and calls printAndFreeACL()
+ * prints the info of the art collections of the database to stdout, sorted by price
  *
  * Params:
  * 	all
@@ -354,54 +458,7 @@ void printBySize(BOOLEAN all, BOOLEAN private){
  * 	void
  */
 void printByPrice(BOOLEAN all, BOOLEAN private){	
-	struct warehouse_sf_list* sf_cursor = sf_head;
-	struct warehouse_list* wl_cursor;
-	struct art_collection_list* acl_head = NULL;
-	struct art_collection_list* acl_cursor = NULL;
-	struct art_collection_list* acl_prev;
-	struct art_collection_list* acl_new;
-	while (sf_cursor){
-		wl_cursor = sf_cursor->warehouse_list_head;
-		while(wl_cursor){
-			if (((wl_cursor->meta_info) & 2) && (all || !((wl_cursor->meta_info) ^ private))){
-				if (acl_head){
-					if (acl_head->art_collection->price > wl_cursor->warehouse->art_collection->price){
-						acl_new = malloc(sizeof(struct art_collection_list));
-						acl_new->art_collection = wl_cursor->warehouse->art_collection;
-						acl_new->next = acl_head;
-						acl_head = acl_new;
-					}
-					else{
-						acl_cursor = acl_head->next;
-						acl_prev = acl_head;
-						while (acl_cursor){
-							if (acl_cursor->art_collection->price > wl_cursor->warehouse->art_collection->price){
-								acl_new = malloc(sizeof(struct art_collection_list));
-								acl_new->art_collection = wl_cursor->warehouse->art_collection;
-								acl_new->next = acl_cursor;
-								acl_prev->next = acl_new;
-								break;
-							}
-							acl_prev = acl_cursor;
-							acl_cursor = acl_cursor->next;
-						}
-						if (!acl_cursor){ 
-							acl_new = malloc(sizeof(struct art_collection_list));
-							acl_new->art_collection = wl_cursor->warehouse->art_collection;
-							acl_new->next = NULL;
-							acl_prev->next = acl_new;
-						}
-					}
-				}
-				else{
-					acl_head = malloc(sizeof(struct art_collection_list));
-					acl_head->art_collection = wl_cursor->warehouse->art_collection;
-					acl_head->next = NULL;
-				}
-			}
-		wl_cursor = wl_cursor->next_warehouse;
-		}
-	sf_cursor = sf_cursor->sf_next_warehouse;
-	}
-	printAndFreeACL(acl_head);
+	STATS_START(timer);
+	printSorted(all, private, FALSE);
+	STATS_STOP(timer, STAT_PRINT_BY_PRICE);
 }
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * defrag
+ * Merges unoccupied root warehouses (loaded ones, or made by coalesce() or by this file) of the same visibility into larger ones, whatever their classes
+ *
+ * Which warehouses are mergeable: two unoccupied root warehouses of the same visibility. A warehouse here is only an ID and a capacity,
+ * so any two of them can be fused into one of their total size (as long as it fits an int). Warehouses split off another one are not
+ * mergeable: they are left to coalesceBuddies(), which merging them elsewhere would break
+ *
+ * When: the defrag command merges every mergeable warehouse of each visibility into one. Otherwise merging only happens on demand,
+ * after an art collection found no unoccupied warehouse large enough (see defragDemand()): up to the budget (-d) of merges are done
+ * after every add and delete, each fusing the two largest free root warehouses of a visibility, until a warehouse large enough for that
+ * art collection is free, or until the free root warehouses of neither visibility add up to its size (merging can't help, so none is done)
+ * The decisions depend only on the commands, which the journal records, so a journal replays to the same database with the same budget
+ *
+ * The free root warehouses of each visibility are kept in a max-heap by size by pushFreeWarehouse() and removeFreeWarehouse()
+ */
+#define DEFRAG_BUCKETS 32
+#define DEFRAG_DEFAULT_BUDGET 4
+
+struct free_roots {
+	struct warehouse_list** heap; // largest first, the older (lower sequence) first among warehouses of the same size
+	uint32_t count;
+	uint32_t capacity;
+	long space; // total size of the warehouses in the heap
+};
+
+static struct free_roots freeRoots[2] = { { NULL, 0, 0, 0 }, { NULL, 0, 0, 0 } }; // indexed by visibility (0 public, 1 private)
+
+static int defragBudget = DEFRAG_DEFAULT_BUDGET;
+static int demand = 0; // size of the last art collection that found no warehouse large enough, 0 if there is none to make room for
+
+/*
+ * heapAbove()
+ * order of the free root heaps
+ *
+ * Params:
+ * 	wl, other
+ * 	free root warehouses
+ *
+ * Return:
+ * 	TRUE if wl goes above other
+ */
+static BOOLEAN heapAbove(struct warehouse_list* wl, struct warehouse_list* other){
+	if (wl->warehouse->size != other->warehouse->size)
+		return wl->warehouse->size > other->warehouse->size;
+	return wl->sequence < other->sequence;
+}
+
+/*
+ * heapPlace()
+ * puts a warehouse at a position of a heap and records the position in it
+ *
+ * Params:
+ * 	roots
+ * 	the heap
+ *
+ * 	position, wl
+ * 	where the warehouse goes and the warehouse
+ *
+ * Return:
+ * 	void
+ */
+static void heapPlace(struct free_roots* roots, uint32_t position, struct warehouse_list* wl){
+	roots->heap[position] = wl;
+	wl->free_root = position + 1;
+}
+
+/*
+ * siftUp()
+ * moves the warehouse at a position of a heap up until its parent goes above it
+ *
+ * Params:
+ * 	roots, position
+ * 	the heap and the position
+ *
+ * Return:
+ * 	void
+ */
+static void siftUp(struct free_roots* roots, uint32_t position){
+	struct warehouse_list* wl = roots->heap[position];
+	while (position && heapAbove(wl, roots->heap[(position - 1) / 2])){
+		heapPlace(roots, position, roots->heap[(position - 1) / 2]);
+		position = (position - 1) / 2;
+	}
+	heapPlace(roots, position, wl);
+}
+
+/*
+ * siftDown()
+ * moves the warehouse at a position of a heap down until neither child goes above it
+ *
+ * Params:
+ * 	roots, position
+ * 	the heap and the position
+ *
+ * Return:
+ * 	void
+ */
+static void siftDown(struct free_roots* roots, uint32_t position){
+	struct warehouse_list* wl = roots->heap[position];
+	while (2 * position + 1 < roots->count){
+		uint32_t child = 2 * position + 1;
+		if (child + 1 < roots->count && heapAbove(roots->heap[child + 1], roots->heap[child]))
+			child++;
+		if (!heapAbove(roots->heap[child], wl))
+			break;
+		heapPlace(roots, position, roots->heap[child]);
+		position = child;
+	}
+	heapPlace(roots, position, wl);
+}
+
+/*
+ * addFreeRoot()
+ * adds an unoccupied root warehouse to the heap of its visibility
+ *
+ * Params:
+ * 	wl
+ * 	the warehouse list member, which has no split record
+ *
+ * Return:
+ * 	void
+ */
+void addFreeRoot(struct warehouse_list* wl){
+	struct free_roots* roots = freeRoots + (wl->meta_info & 1);
+	if (roots->count == roots->capacity){
+		roots->capacity = roots->capacity ? roots->capacity * 2 : 64;
+		roots->heap = realloc(roots->heap, roots->capacity * sizeof(struct warehouse_list*));
+	}
+	roots->heap[roots->count++] = wl;
+	roots->space += wl->warehouse->size;
+	siftUp(roots, roots->count - 1);
+}
+
+/*
+ * removeFreeRoot()
+ * takes a root warehouse out of the heap of its visibility, because it was filled or is being freed
+ *
+ * Params:
+ * 	wl
+ * 	the warehouse list member in the heap
+ *
+ * Return:
+ * 	void
+ */
+void removeFreeRoot(struct warehouse_list* wl){
+	struct free_roots* roots = freeRoots + (wl->meta_info & 1);
+	uint32_t position = wl->free_root - 1;
+	struct warehouse_list* last = roots->heap[--roots->count];
+	roots->space -= wl->warehouse->size;
+	wl->free_root = 0;
+	if (position == roots->count)
+		return;
+	heapPlace(roots, position, last);
+	siftUp(roots, position);
+	siftDown(roots, last->free_root - 1);
+}
+
+/*
+ * clearFreeRoots()
+ * frees both heaps and forgets the demand, when every warehouse is freed at once
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void clearFreeRoots(){
+	free(freeRoots[0].heap);
+	free(freeRoots[1].heap);
+	memset(freeRoots, 0, sizeof(freeRoots));
+	demand = 0;
+}
+
+/*
+ * mergeFreeRoots()
+ * merges the two largest free root warehouses of a visibility into one, which keeps the ID of the largest
+ * the ID of the other dies with it and is handed back to the ID allocator
+ *
+ * Params:
+ * 	private
+ * 	visibility of the warehouses merged
+ *
+ * Return:
+ * 	TRUE if two warehouses were merged, FALSE if there are fewer than two or the merged size wouldn't fit an int
+ */
+static BOOLEAN mergeFreeRoots(BOOLEAN private){
+	struct free_roots* roots = freeRoots + (private & 1);
+	if (roots->count < 2)
+		return FALSE;
+	struct warehouse_list* first = roots->heap[0];
+	struct warehouse_list* second = roots->heap[1];
+	if (roots->count > 2 && heapAbove(roots->heap[2], second))
+		second = roots->heap[2];
+	if (first->warehouse->size > INT_MAX - second->warehouse->size)
+		return FALSE;
+	int id = first->warehouse->id;
+	int size = first->warehouse->size + second->warehouse->size;
+	releaseID(second->warehouse->id);
+	unlinkWarehouseList(findSFList(first->warehouse->size), first);
+	freeWarehouseList(first);
+	unlinkWarehouseList(findSFList(second->warehouse->size), second);
+	freeWarehouseList(second);
+	insertWarehouse(createWarehouse(id, size), private);
+	STATS_COUNT(STAT_COALESCED, 1);
+	return TRUE;
+}
+
+/*
+ * setDefragBudget()
+ * sets how many merges defragStep() may do after a command
+ *
+ * Params:
+ * 	budget
+ * 	number of merges, 0 to only defragment on the defrag command
+ *
+ * Return:
+ * 	void
+ */
+void setDefragBudget(int budget){
+	defragBudget = budget;
+}
+
+/*
+ * defragDemand()
+ * notes that an art collection found no unoccupied warehouse large enough, for defragStep() to make room for the next one of its size
+ *
+ * Params:
+ * 	size
+ * 	size of the art collection
+ *
+ * Return:
+ * 	void
+ */
+void defragDemand(int size){
+	demand = size;
+}
+
+/*
+ * defragStep()
+ * while there is a demand, does up to the budget of merges in the visibility with the most free space, which must be enough for it
+ * the demand is dropped once a warehouse large enough for it is free, or if no visibility has enough free space in its root warehouses
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void defragStep(){
+	int merges;
+	for (merges = 0; demand && merges < defragBudget; merges++){
+		struct warehouse_sf_list* sf;
+		BOOLEAN private = freeRoots[1].space > freeRoots[0].space;
+		if (findFreeWarehouse(demand, &sf) || freeRoots[private & 1].space < demand || !mergeFreeRoots(private))
+			demand = 0;
+	}
+}
+
+/*
+ * printFreeSpace()
+ * prints (through output.c) how many unoccupied warehouses of each visibility there are, by power of two of their size, and their total capacity
+ * the warehouses of each class are counted from its bitmaps
+ *
+ * Params:
+ * 	title
+ * 	first line printed
+ *
+ * Return:
+ * 	void
+ */
+static void printFreeSpace(const char* title){
+	long buckets[DEFRAG_BUCKETS][2];
+	long capacity[2] = { 0, 0 };
+	memset(buckets, 0, sizeof(buckets));
+	struct warehouse_sf_list* sf_cursor;
+	int private;
+	for (sf_cursor = sf_head; sf_cursor; sf_cursor = sf_cursor->sf_next_warehouse){
+		int bucket = 31 - __builtin_clz(sf_cursor->class_size);
+		for (private = 0; private < 2; private++){
+			long count = countClassMembers(sf_cursor, private, FALSE);
+			buckets[bucket][private] += count;
+			capacity[private] += count * sf_cursor->class_size;
+		}
+	}
+	outputFormat("%s\n", title);
+	outputFormat("%-24s%12s%12s\n", "size", "public", "private");
+	int bucket;
+	for (bucket = 0; bucket < DEFRAG_BUCKETS; bucket++){
+		if (!buckets[bucket][0] && !buckets[bucket][1])
+			continue;
+		char range[32];
+		snprintf(range, sizeof(range), "%ld-%ld", 1L << bucket, (2L << bucket) - 1);
+		outputFormat("%-24s%12ld%12ld\n", range, buckets[bucket][0], buckets[bucket][1]);
+	}
+	outputFormat("%-24s%12ld%12ld\n", "free capacity", capacity[0], capacity[1]);
+}
+
+/*
+ * defragment()
+ * merges the free root warehouses of each visibility down to one (if their total size fits an int), printing the free space before and after
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void defragment(){
+	int merges = 0;
+	printFreeSpace("free space before defrag:");
+	while (mergeFreeRoots(FALSE))
+		merges++;
+	while (mergeFreeRoots(TRUE))
+		merges++;
+	demand = 0;
+	printFreeSpace("free space after defrag:");
+	outputFormat("%d merge%s.\n", merges, (merges == 1) ? "" : "s");
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * id_index
+ * Open addressing (linear probing) hash table mapping a warehouse ID to the warehouse list member wrapping it
+ * A key of 0 marks an empty slot, which is safe since badID() rejects every ID that isn't positive
+ * The capacity is always a power of 2 so the probe can wrap with a mask
+ */
+struct id_index {
+	int* keys;
+	struct warehouse_list** values;
+	size_t capacity;
+	size_t count;
+};
+
+static struct id_index idIndex = { NULL, NULL, 0, 0 };
+
+/*
+ * id_allocator
+ * Hands out the IDs of warehouses made by splitting, which live at FIRST_GENERATED_ID and above
+ * IDs destroyed by coalesce() are pushed on a stack to be recycled, otherwise a counter moves up past every ID in use
+ * Anything popped or counted is checked against the ID index, so IDs loaded from a warehouse file are never handed out
+ */
+#define FIRST_GENERATED_ID 5001
+
+struct id_allocator {
+	int next_fresh;
+	int* recycled;
+	size_t recycled_count;
+	size_t recycled_capacity;
+};
+
+static struct id_allocator idAllocator = { FIRST_GENERATED_ID, NULL, 0, 0 };
+
+/*
+ * hashID()
+ * Fibonacci hashing of an ID into a slot of the index
+ *
+ * Params:
+ * 	id
+ * 	the ID to be hashed
+ *
+ * Return:
+ * 	slot to start probing from
+ */
+static size_t hashID(int id){
+	return (size_t)(((uint32_t)id * 0x9E3779B97F4A7C15ull) >> 32) & (idIndex.capacity - 1);
+}
+
+/*
+ * growIDIndex()
+ * doubles the capacity of the index (or makes its first allocation) and rehashes every entry
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+static void growIDIndex(){
+	int* oldKeys = idIndex.keys;
+	struct warehouse_list** oldValues = idIndex.values;
+	size_t oldCapacity = idIndex.capacity;
+	size_t i;
+
+	idIndex.capacity = oldCapacity ? oldCapacity * 2 : 64;
+	idIndex.keys = calloc(idIndex.capacity, sizeof(int));
+	idIndex.values = malloc(idIndex.capacity * sizeof(struct warehouse_list*));
+	for (i=0; i<oldCapacity; i++){
+		if (oldKeys[i]){
+			size_t slot = hashID(oldKeys[i]);
+			while (idIndex.keys[slot])
+				slot = (slot + 1) & (idIndex.capacity - 1);
+			idIndex.keys[slot] = oldKeys[i];
+			idIndex.values[slot] = oldValues[i];
+		}
+	}
+	free(oldKeys);
+	free(oldValues);
+}
+
+/*
+ * indexWarehouse()
+ * adds a warehouse list member to the ID index, replacing the previous entry for its ID if any
+ *
+ * Params:
+ * 	wl
+ * 	the warehouse list member to be indexed by the ID of its warehouse
+ *
+ * Return:
+ * 	void
+ */
+void indexWarehouse(struct warehouse_list* wl){
+	if ((idIndex.count + 1) * 4 > idIndex.capacity * 3)
+		growIDIndex();
+	int id = wl->warehouse->id;
+	size_t slot = hashID(id);
+	while (idIndex.keys[slot] && idIndex.keys[slot] != id)
+		slot = (slot + 1) & (idIndex.capacity - 1);
+	if (!idIndex.keys[slot])
+		idIndex.count++;
+	idIndex.keys[slot] = id;
+	idIndex.values[slot] = wl;
+}
+
+/*
+ * findWarehouse()
+ * looks up the warehouse list member whose warehouse has the specified ID
+ *
+ * Params:
+ * 	id
+ * 	the ID to be looked up
+ *
+ * Return:
+ * 	pointer to the warehouse list member, NULL if no warehouse in the database has that ID
+ */
+struct warehouse_list* findWarehouse(int id){
+	if (!idIndex.count || id <= 0)
+		return NULL;
+	size_t slot = hashID(id);
+	while (idIndex.keys[slot]){
+		if (idIndex.keys[slot] == id)
+			return idIndex.values[slot];
+		slot = (slot + 1) & (idIndex.capacity - 1);
+	}
+	return NULL;
+}
+
+/*
+ * unindexWarehouse()
+ * removes an ID from the index, shifting back any entries of the same probe run so lookups need no tombstones
+ *
+ * Params:
+ * 	id
+ * 	the ID to be removed
+ *
+ * Return:
+ * 	void
+ */
+void unindexWarehouse(int id){
+	if (!idIndex.count || id <= 0)
+		return;
+	size_t mask = idIndex.capacity - 1;
+	size_t hole = hashID(id);
+	while (idIndex.keys[hole] != id){
+		if (!idIndex.keys[hole])
+			return;
+		hole = (hole + 1) & mask;
+	}
+	size_t cursor = hole;
+	while (1){
+		cursor = (cursor + 1) & mask;
+		if (!idIndex.keys[cursor])
+			break;
+		size_t home = hashID(idIndex.keys[cursor]);
+		// the entry can fill the hole only if its home slot is not cyclically within (hole, cursor]
+		if (((cursor - home) & mask) >= ((cursor - hole) & mask)){
+			idIndex.keys[hole] = idIndex.keys[cursor];
+			idIndex.values[hole] = idIndex.values[cursor];
+			hole = cursor;
+		}
+	}
+	idIndex.keys[hole] = 0;
+	idIndex.count--;
+}
+
+/*
+ * freeIDIndex()
+ * frees the memory allocated to the ID index and leaves it empty
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void freeIDIndex(){
+	free(idIndex.keys);
+	free(idIndex.values);
+	idIndex.keys = NULL;
+	idIndex.values = NULL;
+	idIndex.capacity = 0;
+	idIndex.count = 0;
+}
+
+/***********************************************************************************************/
+
+/*
+ * nextGoodID()
+ * finds the next valid ID to be used in cases of splitting a warehouse into 2
+ * a recycled ID is preferred, otherwise the counter is advanced past any ID already in use
+ *
+ * Params: void
+ *
+ * Return:
+ * 	integer ID that can be used by a subsequent warehouse
+ */
+int nextGoodID(){
+	STATS_START(timer);
+	int id = 0;
+	while (!id && idAllocator.recycled_count){
+		id = idAllocator.recycled[--idAllocator.recycled_count];
+		STATS_COUNT(STAT_NODES_TRAVERSED, 1);
+		if (findWarehouse(id))
+			id = 0;
+	}
+	if (!id){
+		while (findWarehouse(idAllocator.next_fresh)){
+			STATS_COUNT(STAT_NODES_TRAVERSED, 1);
+			idAllocator.next_fresh++;
+		}
+		id = idAllocator.next_fresh++;
+	}
+	STATS_STOP(timer, STAT_NEXT_GOOD_ID);
+	return id;
+}
+
+/*
+ * releaseID()
+ * hands the ID of a destroyed warehouse back to the allocator, if it belongs to the generated ID space
+ *
+ * Params:
+ * 	id
+ * 	the ID that is no longer in use
+ *
+ * Return:
+ * 	void
+ */
+void releaseID(int id){
+	if (id < FIRST_GENERATED_ID || id >= idAllocator.next_fresh)
+		return;
+	if (idAllocator.recycled_count == idAllocator.recycled_capacity){
+		idAllocator.recycled_capacity = idAllocator.recycled_capacity ? idAllocator.recycled_capacity * 2 : 64;
+		idAllocator.recycled = realloc(idAllocator.recycled, idAllocator.recycled_capacity * sizeof(int));
+	}
+	idAllocator.recycled[idAllocator.recycled_count++] = id;
+}
+
+/*
+ * resetIDAllocator()
+ * frees the recycled IDs and restarts the counter at FIRST_GENERATED_ID
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void resetIDAllocator(){
+	free(idAllocator.recycled);
+	idAllocator.next_fresh = FIRST_GENERATED_ID;
+	idAllocator.recycled = NULL;
+	idAllocator.recycled_count = 0;
+	idAllocator.recycled_capacity = 0;
+}
+
+/*
+ * getIDAllocator()
+ * exposes the state of the allocator so it can be written to a snapshot
+ *
+ * Params:
+ * 	recycled, recycledCount
+ * 	set to the stack of recycled IDs (bottom first) and its height
+ *
+ * Return:
+ * 	the next fresh ID the counter would try
+ */
+int getIDAllocator(const int** recycled, size_t* recycledCount){
+	*recycled = idAllocator.recycled;
+	*recycledCount = idAllocator.recycled_count;
+	return idAllocator.next_fresh;
+}
+
+/*
+ * validIDAllocator()
+ * checks a state of the allocator read from a snapshot before it is restored
+ *
+ * Params:
+ * 	nextFresh
+ * 	the next fresh ID the counter would try
+ *
+ * 	recycled, recycledCount
+ * 	the stack of recycled IDs (bottom first) and its height
+ *
+ * Return:
+ * 	TRUE if the counter is in the generated ID space and every recycled ID is below it
+ */
+BOOLEAN validIDAllocator(int nextFresh, const int* recycled, size_t recycledCount){
+	if (nextFresh < FIRST_GENERATED_ID)
+		return FALSE;
+	for (size_t i = 0; i < recycledCount; i++)
+		if (recycled[i] < FIRST_GENERATED_ID || recycled[i] >= nextFresh)
+			return FALSE;
+	return TRUE;
+}
+
+/*
+ * restoreIDAllocator()
+ * puts the allocator back in the state returned by getIDAllocator(), so splits after a restore get the same IDs they would have before
+ *
+ * Params:
+ * 	nextFresh
+ * 	the next fresh ID the counter will try
+ *
+ * 	recycled, recycledCount
+ * 	the stack of recycled IDs (bottom first) and its height
+ *
+ * Return:
+ * 	void
+ */
+void restoreIDAllocator(int nextFresh, const int* recycled, size_t recycledCount){
+	resetIDAllocator();
+	if (nextFresh > FIRST_GENERATED_ID)
+		idAllocator.next_fresh = nextFresh;
+	for (size_t i = 0; i < recycledCount; i++)
+		releaseID(recycled[i]);
+}
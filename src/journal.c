@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * journal
+ * Write ahead log of the commands that change the database (add, delete, load and defrag), so a crash loses none of them
+ *
+ * The first line of the journal is its header, naming the epoch of the snapshot ("<journal>.snap.<epoch>") it applies on top of
+ * (epoch 0 has no snapshot). Every following line is one command, as its number of arguments followed by each argument
+ * prefixed by its length ("3 6:delete 3:art 4:mona"), so arguments come back exactly as they were typed
+ *
+ * Commands are written to the file before they are executed, which is enough to survive a crash of the program.
+ * Surviving a crash of the system needs them synced to the disk, which is done for a group of commands at a time:
+ * once JOURNAL_GROUP_COMMANDS are waiting, after the first command (of any kind) that ends JOURNAL_GROUP_NS or more
+ * after the oldest was written (see journalTick()), before the shell waits for input, and when the journal is closed
+ * So a command is durable at the latest when the command running JOURNAL_GROUP_NS after it ends, or as soon as the shell is idle
+ *
+ * Compaction saves the database as the snapshot of the next epoch, then atomically replaces the journal by an empty
+ * one of that epoch, so a crash at any point recovers either the old snapshot and journal or the new ones
+ * It happens on the compact command and once the journal weighs JOURNAL_COMPACT_BYTES: its own size plus the size of
+ * the files its loads name, which replaying reads again. The journal only records those names, so loaded files must
+ * stay as they are until the next compaction (the compact command folds them in at once)
+ */
+#define JOURNAL_HEADER "# art_db journal epoch "
+#define JOURNAL_GROUP_COMMANDS 64
+#define JOURNAL_GROUP_NS 50000000L
+#define JOURNAL_COMPACT_BYTES (64L * 1024 * 1024)
+
+struct journal {
+	char* file_name;
+	int fd;
+	unsigned long epoch;
+	int pending; // commands written since the last sync
+	struct timespec first_pending;
+	off_t weight; // size of the journal plus the files its loads read, see commandWeight()
+	BOOLEAN replaying;
+};
+
+static struct journal journal = { NULL, -1, 0, 0, { 0, 0 }, 0, FALSE };
+
+/*
+ * snapshotName()
+ * builds the name of the snapshot of an epoch of the journal
+ *
+ * Params:
+ * 	epoch
+ * 	the epoch of the snapshot
+ *
+ * Return:
+ * 	malloc()'d name of the snapshot
+ */
+static char* snapshotName(unsigned long epoch){
+	size_t length = strlen(journal.file_name) + 32;
+	char* output = malloc(length);
+	snprintf(output, length, "%s.snap.%lu", journal.file_name, epoch);
+	return output;
+}
+
+/*
+ * writeFully()
+ * writes a whole buffer to a file descriptor, retrying short writes
+ *
+ * Params:
+ * 	fd
+ * 	the file descriptor written to
+ *
+ * 	data, length
+ * 	the buffer to be written
+ *
+ * Return:
+ * 	TRUE if every byte was written
+ */
+static BOOLEAN writeFully(int fd, const char* data, size_t length){
+	while (length){
+		ssize_t written = write(fd, data, length);
+		if (written <= 0)
+			return FALSE;
+		data += written;
+		length -= written;
+	}
+	return TRUE;
+}
+
+/*
+ * commandWeight()
+ * what a journaled command adds to the weight that triggers compaction: the length of its record, plus for a load the size
+ * of the file it names, since replaying it reads that whole file again
+ *
+ * Params:
+ * 	args
+ * 	the arguments of the command
+ *
+ * 	recordLength
+ * 	length of its record in the journal
+ *
+ * Return:
+ * 	the weight of the command
+ */
+static off_t commandWeight(char** args, size_t recordLength){
+	off_t weight = recordLength;
+	struct stat info;
+	if (!strcmp(*args, "load") && args[1] && args[2] && !stat(args[2], &info))
+		weight += info.st_size;
+	return weight;
+}
+
+/*
+ * createJournal()
+ * atomically replaces the journal by an empty one of the given epoch and opens it for appending
+ *
+ * Params:
+ * 	epoch
+ * 	epoch written to the header of the new journal
+ *
+ * Return:
+ * 	TRUE if the new journal is in place
+ */
+static BOOLEAN createJournal(unsigned long epoch){
+	size_t length = strlen(journal.file_name);
+	char* tempName = malloc(length + 5);
+	memcpy(tempName, journal.file_name, length);
+	memcpy(tempName + length, ".tmp", 5);
+	char header[64];
+	int headerLength = snprintf(header, sizeof(header), JOURNAL_HEADER "%lu\n", epoch);
+	int fd = open(tempName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || !writeFully(fd, header, headerLength) || fsync(fd) || rename(tempName, journal.file_name)){
+		printError("failed to write the journal %s\n", journal.file_name);
+		if (fd >= 0){
+			close(fd);
+			remove(tempName);
+		}
+		free(tempName);
+		return FALSE;
+	}
+	free(tempName);
+	if (journal.fd >= 0)
+		close(journal.fd);
+	journal.fd = fd;
+	journal.epoch = epoch;
+	journal.pending = 0;
+	journal.weight = headerLength;
+	return TRUE;
+}
+
+/*
+ * replayCommand()
+ * parses one command of the journal and executes it
+ * arguments are found by their length rather than by separators, since one may hold a newline
+ *
+ * Params:
+ * 	record
+ * 	start of the command, whose arguments are NUL terminated in place
+ *
+ * 	end
+ * 	end of the journal
+ *
+ * Return:
+ * 	start of the next command, or NULL if the command is incomplete (i.e. cut short by a crash)
+ */
+static char* replayCommand(char* record, char* end){
+	char* cursor;
+	long argc = strtol(record, &cursor, 10);
+	if (cursor == record || argc < 1 || argc > 16 || cursor >= end || *cursor != ' ')
+		return NULL;
+	char* args[17];
+	for (long i = 0; i < argc; i++){
+		char* start = cursor + 1;
+		unsigned long length = strtoul(start, &cursor, 10);
+		if (cursor == start || cursor >= end || *cursor != ':' || length >= (unsigned long)(end - cursor - 1))
+			return NULL;
+		args[i] = cursor + 1;
+		cursor += 1 + length;
+		if (*cursor != (i + 1 == argc ? '\n' : ' '))
+			return NULL;
+		*cursor = '\0';
+	}
+	args[argc] = NULL;
+	journal.weight += commandWeight(args, cursor + 1 - record);
+	executeCommand(args);
+	return cursor + 1;
+}
+
+/*
+ * openJournal()
+ * recovers the database from a journal (and the snapshot it applies on top of), then keeps appending to it
+ * the output of the replayed commands was already shown when they were first run, so it is discarded
+ * a command cut short by a crash is dropped from the end of the journal
+ *
+ * Params:
+ * 	fileName
+ * 	path of the journal, created if it doesn't exist
+ *
+ * Return:
+ * 	TRUE if the database was recovered and the journal is open
+ */
+BOOLEAN openJournal(char* fileName){
+	journal.file_name = fileName;
+	FILE* file = fopen(fileName, "r");
+	if (!file)
+		return createJournal(0);
+	size_t length = 0;
+	size_t capacity = 64 * 1024;
+	size_t bytes;
+	char* contents = malloc(capacity + 1);
+	while ((bytes = fread(contents + length, 1, capacity - length, file))){
+		length += bytes;
+		if (length == capacity){
+			capacity *= 2;
+			contents = realloc(contents, capacity + 1);
+		}
+	}
+	fclose(file);
+	contents[length] = '\0'; // stops strtol() and strtoul() at the end of the journal
+	char* end = contents + length;
+
+	size_t headerLength = strlen(JOURNAL_HEADER);
+	char* record = memchr(contents, '\n', length);
+	if (!record || length <= headerLength || strncmp(contents, JOURNAL_HEADER, headerLength)){
+		printError("%s is not a journal.\n", fileName);
+		free(contents);
+		return FALSE;
+	}
+	record++;
+	journal.epoch = strtoul(contents + headerLength, NULL, 10);
+	if (journal.epoch){
+		char* snapshot = snapshotName(journal.epoch);
+		BOOLEAN loaded = loadSnapshot(snapshot);
+		free(snapshot);
+		if (!loaded){
+			free(contents);
+			return FALSE;
+		}
+	}
+
+	int savedStdout = silenceOutput();
+	journal.replaying = TRUE;
+	journal.weight = record - contents;
+	char* next;
+	off_t complete = record - contents;
+	while (record < end && (next = replayCommand(record, end))){
+		complete += next - record;
+		record = next;
+	}
+	journal.replaying = FALSE;
+	restoreOutput(savedStdout);
+	free(contents);
+
+	journal.fd = open(fileName, O_WRONLY | O_APPEND);
+	if (journal.fd < 0 || ftruncate(journal.fd, complete)){
+		printError("failed to open the journal %s\n", fileName);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * journalOpen()
+ * tells whether commands are being journaled (i.e. -j was given and no replay is under way)
+ *
+ * Params:	void
+ *
+ * Return:
+ * 	TRUE if the journal is open
+ */
+BOOLEAN journalOpen(){
+	return journal.fd >= 0 && !journal.replaying;
+}
+
+/*
+ * syncJournal()
+ * makes every command written so far durable
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void syncJournal(){
+	if (journal.fd >= 0 && journal.pending){
+		fdatasync(journal.fd);
+		journal.pending = 0;
+	}
+}
+
+/*
+ * journalCommand()
+ * appends a command to the journal if it changes the database, syncing it with the other commands of its group once the group is full
+ *
+ * Params:
+ * 	args
+ * 	the arguments of the command, before it is executed
+ *
+ * Return:
+ * 	void
+ */
+void journalCommand(char** args){
+	if (!journalOpen() || !*args)
+		return;
+	if (strcmp(*args, "add") && strcmp(*args, "delete") && strcmp(*args, "load") && strcmp(*args, "defrag"))
+		return;
+	int argc = 0;
+	size_t length = 16;
+	while (args[argc]){
+		length += strlen(args[argc]) + 24;
+		argc++;
+	}
+	char* record = malloc(length);
+	size_t used = snprintf(record, length, "%d", argc);
+	for (int i = 0; i < argc; i++)
+		used += snprintf(record + used, length - used, " %zu:%s", strlen(args[i]), args[i]);
+	record[used++] = '\n';
+	if (!writeFully(journal.fd, record, used))
+		printError("failed to write the journal %s\n", journal.file_name);
+	free(record);
+	journal.weight += commandWeight(args, used);
+
+	if (!journal.pending++)
+		clock_gettime(CLOCK_MONOTONIC, &journal.first_pending);
+	if (journal.pending >= JOURNAL_GROUP_COMMANDS)
+		syncJournal();
+}
+
+/*
+ * journalTick()
+ * runs after every command, whether it was journaled or not: syncs the waiting group if its oldest command has waited
+ * JOURNAL_GROUP_NS, and compacts the journal once it weighs JOURNAL_COMPACT_BYTES
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void journalTick(){
+	if (!journalOpen())
+		return;
+	if (journal.pending){
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec - journal.first_pending.tv_sec) * 1000000000L + now.tv_nsec - journal.first_pending.tv_nsec >= JOURNAL_GROUP_NS)
+			syncJournal();
+	}
+	if (journal.weight >= JOURNAL_COMPACT_BYTES)
+		compactJournal();
+}
+
+/*
+ * compactJournal()
+ * folds the journal into a snapshot of the whole database and starts an empty journal on top of it
+ *
+ * Params:	void
+ *
+ * Return:
+ * 	TRUE if the journal was compacted
+ */
+BOOLEAN compactJournal(){
+	if (!journalOpen())
+		return FALSE;
+	syncJournal();
+	char* snapshot = snapshotName(journal.epoch + 1);
+	BOOLEAN compacted = saveSnapshot(snapshot) && createJournal(journal.epoch + 1);
+	free(snapshot);
+	if (compacted && journal.epoch > 1){
+		snapshot = snapshotName(journal.epoch - 1);
+		remove(snapshot);
+		free(snapshot);
+	}
+	return compacted;
+}
+
+/*
+ * closeJournal()
+ * syncs and closes the journal
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void closeJournal(){
+	syncJournal();
+	if (journal.fd >= 0)
+		close(journal.fd);
+	journal.fd = -1;
+}
@@ -6,6 +6,24 @@
 #define TRUE 1
 #define FALSE 0
 
+struct warehouse_sf_list* sf_head;
+
+static unsigned long warehouseSequence = 0; // last sequence stamped on an appended warehouse list member
+
+/*
+ * utilization_counters
+ * Running totals behind printUtilization(), each indexed by visibility (0 public, 1 private)
+ * Kept up to date wherever a warehouse is inserted, filled, emptied or freed
+ */
+struct utilization_counters {
+	long warehouses[2];
+	long occupied[2];
+	long capacity[2];
+	long art_size[2];
+};
+
+static struct utilization_counters utilization = { {0, 0}, {0, 0}, {0, 0}, {0, 0} };
+
 /*
  * badInt()
  * Checks to see if the ID is valid
@@ -14,53 +32,28 @@
  * 		the ID to be checked
  *
  * 		userInput
- * 		if true, it gives the user feedback, if not, the feedback is suppressed (for use in nextGoodID())
+ * 		if true, it gives the user feedback, if not, the feedback is suppressed
  *
- * Return:	TRUE if ID is negative or if a warehouse in the data structure already has that ID
+ * Return:	TRUE if ID is negative or if a warehouse in the data structure already has that ID (looked up in the ID index)
  * 		FALSE otherwise
  */
 BOOLEAN badID(int id, BOOLEAN userInput){
+	STATS_START(timer);
+	BOOLEAN bad = FALSE;
 	if (id<=0){
 		if(userInput)
-			printf("ERROR: All ID's must be positive. %d is not!\n", id);
-		return TRUE;
+			printError("All ID's must be positive. %d is not!\n", id);
+		bad = TRUE;
 	}
-	if (!sf_head)
-		return FALSE;
-	else{
-		struct warehouse_sf_list* sf_cursor = sf_head;
-		struct warehouse_list* wl_cursor;
-		while (sf_cursor){
-			wl_cursor = sf_cursor->warehouse_list_head;
-			while (wl_cursor){
-				if (id == wl_cursor->warehouse->id){
-					if (userInput)
-						printf("ERROR: All ID's must be unique. %d is not!", id);
-					return TRUE;
-				}
-				wl_cursor = wl_cursor->next_warehouse;
-			}
-			sf_cursor = sf_cursor->sf_next_warehouse;
-		}
-		return FALSE;
+	else if (findWarehouse(id)){
+		if (userInput)
+			printError("All ID's must be unique. %d is not!", id);
+		bad = TRUE;
 	}
+	STATS_STOP(timer, STAT_BAD_ID);
+	return bad;
 }
 
-/*
- * nextGoodID()
- * finds the next valid ID to be used in cases of splitting a warehouse into 2
- *
- * Params: void
- *
- * Return:
- * 	integer ID that can be used by a subsequent warehouse
- */
-int nextGoodID(){
-	int output = 5000;
-	while (badID(++output, FALSE));
-	return output;
-}	
-
 /*
  * createWarehouse()
  * allocates space for a Warehouse struct, initialized with a unique ID, a specified size, and a NULL art collection
@@ -73,17 +66,17 @@ int nextGoodID(){
  * 	the storage capacity of the warehouse
  *
  * Return:
- * 	pointer to a newly malloc'd warehouse struct
+ * 	pointer to a new warehouse struct from the warehouse pool
  */
 struct warehouse* createWarehouse(int id, int size){
 	if (badID(id, TRUE)){
 		return NULL;
 	}
 	if ((size & 1) || (size<4)){
-		printf("ERROR: warehouse size must be a multiple of 2 and greated than 4, %d has size of %d\n", id, size);
+		printError("warehouse size must be a multiple of 2 and greated than 4, %d has size of %d\n", id, size);
 		return NULL;
 	}
-	struct warehouse* output = malloc(sizeof(struct warehouse));
+	struct warehouse* output = poolAlloc(&warehousePool);
 	output->id = id;
 	output->size = size;
 	output->art_collection = NULL;
@@ -92,7 +85,7 @@ struct warehouse* createWarehouse(int id, int size){
 
 /*
  * createWarehouseList()
- * malloc's space for a member of a warehouse list and initializes its values
+ * allocates a member of a warehouse list from its pool and initializes its values
  *
  * Params: 
  * 	warehouse
@@ -102,40 +95,55 @@ struct warehouse* createWarehouse(int id, int size){
  * 	BOOLEAN used to initialized the single bit of meta_info to indicate if the warehouse is private or public
  *
  * Return:	
- * 	pointer to newly malloc'd warehouse struct
+ * 	pointer to the new warehouse list struct
  */
 struct warehouse_list* createWarehouseList(struct warehouse* warehouse, BOOLEAN private){
-	struct warehouse_list* output = malloc(sizeof(struct warehouse_list));
+	struct warehouse_list* output = poolAlloc(&warehouseListPool);
 	output->warehouse = warehouse;
 	output->meta_info = ((warehouse->size)<<1) | (private & 1);
-	output->next_warehouse = NULL;
+	output->slot = 0;
+	output->free_root = 0;
+	output->next_same_name = NULL;
+	output->prev_same_name = NULL;
+	output->sequence = 0;
+	output->split = NULL;
 	return output;
 }
 
 /*
  * createWarehouseSFList()
- * allocates memory for a new class size of warehouses for the segregated free list
+ * allocates a new class size of warehouses for the segregated free list from its pool
  * 
  * Params:
  * 	class_size
- *	size all members of its warehouse list will be
- *	
- *	warehouse_list_head
- *	Since this function is only called if a warehouse is created, but an entry in the Segregated List is yet to exist, that newly created warehouse will be the beginning of the list for its class size
+ *	size all members of the class will be
  * 
  * Return:
- * 	pointer to the newly malloc'd warehouse_sf_list [member]
+ * 	pointer to the new warehouse_sf_list [member], without any member yet
  */
-struct warehouse_sf_list* createWarehouseSFList(int class_size, struct warehouse_list* warehouse_list_head){
-	struct warehouse_sf_list* output = malloc(sizeof(struct warehouse_sf_list));
+struct warehouse_sf_list* createWarehouseSFList(int class_size){
+	struct warehouse_sf_list* output = poolAlloc(&warehouseSFListPool);
 	output->class_size = class_size;
-	output->warehouse_list_head = warehouse_list_head;
+	output->sf_next_warehouse = NULL;
+	output->directory_index = 0;
+	output->slots = NULL;
+	output->ids = NULL;
+	output->arts = NULL;
+	output->live_bits = NULL;
+	output->free_bits = NULL;
+	output->private_bits = NULL;
+	output->slot_count = 0;
+	output->slot_capacity = 0;
+	output->holes = 0;
+	output->free_count = 0;
+	output->first_free_word = 0;
 	return output;
 }
 
 /*
  * insertWarehouseSFList()
  * inserts a the new member of the segrated free list in its correct position relative to the already inserted members
+ * the position is found by the size directory, which the member is added to as well
  *
  * Params:	
  * 	toBeInserted
@@ -147,55 +155,41 @@ struct warehouse_sf_list* createWarehouseSFList(int class_size, struct warehouse
 void insertWarehouseSFList(struct warehouse_sf_list* toBeInserted){
 	if (!toBeInserted)
 		return;
-	if (!sf_head){
-		sf_head = toBeInserted;
+	struct warehouse_sf_list* prev = addSFList(toBeInserted);
+	if (prev){
+		toBeInserted->sf_next_warehouse = prev->sf_next_warehouse;
+		prev->sf_next_warehouse = toBeInserted;
 	}
 	else{
-		if (sf_head->class_size > toBeInserted->class_size){
-			toBeInserted->sf_next_warehouse = sf_head;
-			sf_head = toBeInserted;
-			return;
-		}
-		struct warehouse_sf_list* cursor = sf_head->sf_next_warehouse;
-		struct warehouse_sf_list* prev = cursor;
-		while (cursor){
-			if (cursor->class_size > toBeInserted->class_size){
-				toBeInserted->sf_next_warehouse = cursor;
-				prev->sf_next_warehouse = toBeInserted;
-				return;
-			}
-			prev = cursor;
-			cursor = cursor->sf_next_warehouse;
-		}
-		prev->sf_next_warehouse = toBeInserted;
-		toBeInserted->sf_next_warehouse = NULL;
+		toBeInserted->sf_next_warehouse = sf_head;
+		sf_head = toBeInserted;
 	}
 }
 
 /*
  * insertWarehouseList
- * inserts a warehouse list into a new SF List member, since insertWarehouse() appends warehouse lists to already made SF List members
+ * inserts a new SF List member for the class of a warehouse list, since insertWarehouse() appends warehouse lists to already made SF List members
  * 
  * Params: 
  * 	warehouse_list
- * 	list to be the head of a new SF List member
+ * 	the first member of the new SF List member, which is yet to be added to it
  *
  * Return:
- * 	void
+ * 	the new SF List member
  */
-void insertNewWarehouseList(struct warehouse_list* warehouse_list){
+struct warehouse_sf_list* insertNewWarehouseList(struct warehouse_list* warehouse_list){
 	if (!warehouse_list)
-		return;
+		return NULL;
 	int class_size = (warehouse_list->meta_info >> 1) & -2;
 	
-	struct warehouse_sf_list* new_sf = createWarehouseSFList( class_size, warehouse_list );
+	struct warehouse_sf_list* new_sf = createWarehouseSFList( class_size );
 	insertWarehouseSFList(new_sf);
-	new_sf->warehouse_list_head = warehouse_list;
+	return new_sf;
 }
 
 /*
  * insertWarehouse()
- * Creates a new warehouse list member (as a wrapper) either appends it to the SF List of its class size, or creates a new SF List of its class size
+ * inserts a warehouse with insertWarehouseHalf(), as a root warehouse (one that no split made)
  *
  * Params:
  * 	warehouse
@@ -208,68 +202,52 @@ void insertNewWarehouseList(struct warehouse_list* warehouse_list){
  * 	void
  */
 void insertWarehouse(struct warehouse* warehouse, BOOLEAN private){
-	if (!warehouse)
-		return;
-	if (!sf_head){
-		insertNewWarehouseList( createWarehouseList( warehouse, private ));
-		return;
-	}
-	struct warehouse_sf_list* sf_cursor = sf_head;
-	while (sf_cursor){
-		if (sf_cursor->class_size == warehouse->size){
-			struct warehouse_list* wl_cursor = sf_cursor->warehouse_list_head;
-			if (!wl_cursor){
-				sf_cursor->warehouse_list_head = createWarehouseList(warehouse, private);
-				return;
-			}
-			while (wl_cursor->next_warehouse){
-				wl_cursor = wl_cursor->next_warehouse;
-			}
-			wl_cursor->next_warehouse = createWarehouseList(warehouse, private);
-			return;
-		}
-		sf_cursor = sf_cursor->sf_next_warehouse;
-	}
-	insertNewWarehouseList( createWarehouseList( warehouse, private ));
+	insertWarehouseHalf(warehouse, private, NULL, 0);
 }
 
 /*
- * loadWarehouseFile()
- * creates and inserts warehouses from file each specified by ID SIZE TYPE\n
+ * insertWarehouseHalf()
+ * Creates a new warehouse list member (as a wrapper), adds it to the ID index, and appends it (in the next slot) to the SF List of its class size, creating a new SF List of its class size if there is none
+ * It takes the next slot of its class and, being unoccupied, is marked free in its bitmap
+ * Its split record is set before it is marked free, since free root warehouses are also kept for defrag.c
  *
  * Params:
- * 	warehouseFile
- * 	pointer to the opened file to be read
+ * 	warehouse
+ * 	warehouse to be wrapped and inserted
+ *
+ * 	private
+ * 	BOOLEAN to indicate whether the warehouse is private or public
+ *
+ * 	split, side
+ * 	the split record the warehouse is a half of and which half it is, or NULL for a root warehouse
  *
  * Return:
- * 	void
+ * 	the new warehouse list member, NULL if warehouse is NULL
  */
-
-void loadWarehouseFile(FILE* warehouseFile){
-	char* commandLine = malloc(256 * sizeof(char*));
-	char** args;
-	int id;
-	int size;
-	BOOLEAN private;
-	while (fgets(commandLine, 255, warehouseFile) != NULL){
-		args = commandSplitter(commandLine, 3);
-		if (args && (args+1) && (args+2)){
-			id = atoi(*args);
-			size = atoi(*(args+1));
-			private = atoi(*(args+2));
-			insertWarehouse( createWarehouse(id, size), private);
-		}
-		if (args)
-			free(args);
-	}
-	free(commandLine);
+struct warehouse_list* insertWarehouseHalf(struct warehouse* warehouse, BOOLEAN private, struct warehouse_split* split, int side){
+	if (!warehouse)
+		return NULL;
+	struct warehouse_list* wl = createWarehouseList(warehouse, private);
+	wl->split = split;
+	if (split)
+		split->halves[side] = wl;
+	wl->sequence = ++warehouseSequence;
+	indexWarehouse(wl);
+	utilization.warehouses[private & 1]++;
+	utilization.capacity[private & 1] += warehouse->size;
+	struct warehouse_sf_list* sf = findSFList(warehouse->size);
+	if (!sf)
+		sf = insertNewWarehouseList(wl);
+	addClassMember(sf, wl);
+	pushFreeWarehouse(sf, wl);
+	return wl;
 }
 
 /***********************************************************************************************/
 
 /*
  * freeWarehouse()
- * Frees the memory allocated to the specified warehouse and its dependencies if any
+ * Gives the specified warehouse and its dependencies if any back to their pools
  *
  * Params:
  * 	warehouse
@@ -279,17 +257,14 @@ void loadWarehouseFile(FILE* warehouseFile){
  * 	void
  */
 void freeWarehouse(struct warehouse* warehouse){
-	if (warehouse->art_collection){
-		if (warehouse->art_collection->name)
-			free(warehouse->art_collection->name);
-		free(warehouse->art_collection);
-	}
-	free(warehouse);
+	if (warehouse->art_collection)
+		freeArtCollection(warehouse->art_collection);
+	poolFree(&warehousePool, warehouse);
 }
 
 /*
  * freeWarehouseList()
- * frees the memory allocated to a warehouse list member and calls freeWarehouse() on its encompassed warehouse
+ * gives a warehouse list member back to its pool, removes it from the utilization counters and its ID from the ID index, and calls freeWarehouse() on its encompassed warehouse
  *
  * Params:
  * 	wl
@@ -299,129 +274,239 @@ void freeWarehouse(struct warehouse* warehouse){
  * 	void
  */
 void freeWarehouseList(struct warehouse_list* wl){
-	if (wl->warehouse)
+	if (wl->warehouse){
+		int private = wl->meta_info & 1;
+		utilization.warehouses[private]--;
+		utilization.capacity[private] -= wl->warehouse->size;
+		if ((wl->meta_info & 2) && wl->warehouse->art_collection){
+			utilization.occupied[private]--;
+			utilization.art_size[private] -= wl->warehouse->art_collection->size;
+		}
+		unindexWarehouse(wl->warehouse->id);
 		freeWarehouse(wl->warehouse);
-	free(wl);
+	}
+	poolFree(&warehouseListPool, wl);
 }
 
 /*
- * freeAllWarehouseList()
- * frees all the warehouse of the same class size
+ * freeAllWarehouseSFList()
+ * frees the entirety of the Segregated List including all dependacies (warehouse_lists, warehouses, art_collections, their names)
+ * by freeing the size directory and releasing their pools and the string table in bulk, then resets the utilization counters, the sorted views,
+ * the free root lists, the name index, the ID index and the ID allocator
  *
  * Params:
- * 	warehouse_list_head 
- * 	head of the list of the class size to be freed
- *
+ * 	void
+ * 
  * Return:
  * 	void
  */
-void freeAllWarehouseList(struct warehouse_list* warehouse_list_head){
-	struct warehouse_list* cursor = warehouse_list_head;
-	struct warehouse_list* temp;
-	while (cursor){
-		temp = cursor;
-		cursor = cursor->next_warehouse;
-		freeWarehouseList(temp);
-	}
+void freeAllWarehouseSFList(){
+	sf_head = NULL;
+	freeSizeDirectory(); // before the pools, as it frees the slots of the classes
+	poolRelease(&artCollectionPool);
+	poolRelease(&warehousePool);
+	poolRelease(&warehouseListPool);
+	poolRelease(&warehouseSFListPool);
+	poolRelease(&warehouseSplitPool);
+	releaseStringTable();
+	memset(&utilization, 0, sizeof(utilization));
+	clearSortedViews();
+	clearFreeRoots();
+	freeNameIndex();
+	freeIDIndex();
+	resetIDAllocator();
 }
 
+
+/***********************************************************************************************/
+
 /*
- * freeAllWarehouseSFList()
- * frees the entirety of the Segregated List including all dependacies (warehouse_lists, warehouses, art_collections)
+ * unlinkWarehouseList()
+ * takes a member out of the slots of its class (and off its free bitmap if it is unoccupied) without freeing it
  *
  * Params:
- * 	void
- * 
+ * 	sf
+ * 	the member of the sf list of which the warehouse is apart
+ *
+ * 	wl
+ * 	the member to be unlinked
+ *
  * Return:
  * 	void
  */
-void freeAllWarehouseSFList(){
-	if (!sf_head)
-		return;
-	struct warehouse_sf_list* cursor = sf_head;
-	struct warehouse_sf_list* temp;
-	while (cursor){
-		freeAllWarehouseList(cursor->warehouse_list_head);
-		temp = cursor;
-		cursor = cursor->sf_next_warehouse;
-		free(temp);
-	}
+void unlinkWarehouseList(struct warehouse_sf_list* sf, struct warehouse_list* wl){
+	if (!(wl->meta_info & 2))
+		removeFreeWarehouse(sf, wl);
+	removeClassMember(sf, wl);
 }
 
+/*
+ * splitWarehouse()
+ * splits an unoccupied warehouse in two, the first half keeping its ID, and records the split so coalesce() can undo it
+ *
+ * Params:
+ * 	sf
+ * 	the member of the sf list of which the warehouse is apart
+ *
+ * 	wl
+ * 	the warehouse to be split
+ *
+ * 	firstSize
+ * 	size of the first half, the second half gets the rest
+ *
+ * Return:
+ * 	the split record, whose halves are the two new warehouse list members
+ */
+struct warehouse_split* splitWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl, int firstSize){
+	struct warehouse_split* split = poolAlloc(&warehouseSplitPool);
+	split->parent = wl->split;
+	split->side = wl->split && wl->split->halves[1] == wl;
+	split->index = 0;
+	if (split->parent)
+		split->parent->halves[split->side] = NULL;
 
-/***********************************************************************************************/
+	// the first half keeps the ID, so the split warehouse is freed (and unindexed) before the halves are created
+	int id = wl->warehouse->id;
+	int size = wl->warehouse->size;
+	BOOLEAN private = wl->meta_info & 1;
+	unlinkWarehouseList(sf, wl);
+	freeWarehouseList(wl);
+	insertWarehouseHalf(createWarehouse(	id,		firstSize),		private,	split,	0);
+	insertWarehouseHalf(createWarehouse(	nextGoodID(),	size - firstSize),	private,	split,	1);
+	STATS_COUNT(STAT_SPLITS, 1);
+	return split;
+}
+
+/*
+ * coalesceBuddies()
+ * merges a freed warehouse with its buddy (the other half of the split that made it) while the buddy is unoccupied and
+ * of the same type (private/public), then does the same for the merged warehouse, up the splits recorded by splitWarehouse()
+ *
+ * Params:
+ * 	wl
+ * 	the emptied warehouse, which has a split record
+ *
+ * Return:
+ * 	void
+ */
+static void coalesceBuddies(struct warehouse_list* wl){
+	while (wl->split){
+		struct warehouse_split* split = wl->split;
+		struct warehouse_list* buddy = split->halves[split->halves[0] == wl];
+		STATS_COUNT(STAT_NODES_TRAVERSED, 1);
+		if (!buddy || (buddy->meta_info & 2) || ((buddy->meta_info ^ wl->meta_info) & 1))
+			break;
+
+		// the merged warehouse keeps the ID of the first half (the ID of the split warehouse), the second half's ID dies with it
+		struct warehouse_list* first = split->halves[0];
+		struct warehouse_list* second = split->halves[1];
+		int id = first->warehouse->id;
+		int size = first->warehouse->size + second->warehouse->size;
+		BOOLEAN private = wl->meta_info & 1;
+		releaseID(second->warehouse->id);
+		unlinkWarehouseList(findSFList(first->warehouse->size), first);
+		freeWarehouseList(first);
+		unlinkWarehouseList(findSFList(second->warehouse->size), second);
+		freeWarehouseList(second);
+		wl = insertWarehouseHalf(createWarehouse(id, size), private, split->parent, split->side);
+		poolFree(&warehouseSplitPool, split);
+		STATS_COUNT(STAT_COALESCED, 1);
+	}
+}
 
 /* coalesce()
- * When emptying a warehouse, this checks if the surrounding warehouses are also empty and of the same type (private/public)
+ * When emptying a warehouse that was split off another one, this merges it with its buddy (see coalesceBuddies())
+ * Otherwise (a loaded warehouse) this checks if the surrounding warehouses of its class are also empty, loaded and of the same type (private/public)
  * If so, it is coalesced with the ones which match that criteria
  *
  * Params:
  * 	sf
  * 	the member of the sf list of which the warehouses are apart (so we need not iterate through the list again)
  *
- * 	wl_prev_prev
- * 	the member (if any) of the sf list 2 back from the emptying warehouse (since the database is singly linked)
- *	provided so if wl_prev is coalesced, it's next_warehouse can update accordingly
- *
- * 	wl_prev
- * 	the member (if any) of the sf list behind the emptying warehouse (since the database is singly linked)
- *
  * 	wl
- * 	the emptying warehouse
+ * 	the emptying warehouse, whose neighbours are the members of the closest slots before and after it
  *
  * Return:
  * 	void
  */
-void coalesce(struct warehouse_sf_list* sf, struct warehouse_list* wl_prev_prev, struct warehouse_list* wl_prev, struct warehouse_list* wl){
+void coalesce(struct warehouse_sf_list* sf, struct warehouse_list* wl){
+	STATS_START(timer);
+	if (wl->split){
+		coalesceBuddies(wl);
+		STATS_STOP(timer, STAT_COALESCE);
+		return;
+	}
+	struct warehouse_list* wl_prev = previousClassMember(sf, wl);
+	struct warehouse_list* wl_next = nextClassMember(sf, wl);
+	BOOLEAN withPrev = (wl_prev) && !(wl_prev->meta_info & 2) && !wl_prev->split && !((wl->meta_info & 1) ^ (wl_prev->meta_info & 1));
+	BOOLEAN withNext = (wl_next) && !(wl_next->meta_info & 2) && !wl_next->split && !((wl->meta_info & 1) ^ (wl_next->meta_info & 1));
+	STATS_COUNT(STAT_NODES_TRAVERSED, (wl_prev != NULL) + (wl_next != NULL));
+	if (!withPrev && !withNext){
+		STATS_STOP(timer, STAT_COALESCE);
+		return;
+	}
 
-	if ((wl_prev) && !(wl_prev->meta_info & 2) && !((wl->meta_info & 1) ^ (wl_prev->meta_info & 1))){
-		
-		if ((wl->next_warehouse) && !(wl->next_warehouse->meta_info & 2) && !((wl->meta_info & 1) ^ (wl->next_warehouse->meta_info & 1))){
-			if (wl_prev_prev){
-				wl_prev_prev->next_warehouse = wl->next_warehouse->next_warehouse;
-			}
-			else{
-				sf->warehouse_list_head = wl->next_warehouse->next_warehouse;
-			}
-			insertWarehouse( createWarehouse( wl->warehouse->id, wl->warehouse->size * 3), wl->meta_info & 1);
-			freeWarehouseList(wl->next_warehouse);
-			freeWarehouseList(wl);
-			freeWarehouseList(wl_prev);
-		}
-		else {
-			if (wl_prev_prev){
-				wl_prev_prev->next_warehouse = wl->next_warehouse;
-			}
-			else{
-				sf->warehouse_list_head = wl->next_warehouse;
-			}
-			insertWarehouse( createWarehouse( wl->warehouse->id, wl->warehouse->size * 2), wl->meta_info & 1);
-			freeWarehouseList(wl);
-			freeWarehouseList(wl_prev);
-		}
+	// the merged warehouse keeps wl's ID, so the members are freed (and unindexed) before it is created
+	// the IDs of the other members die with them and are handed back to the ID allocator
+	int id = wl->warehouse->id;
+	int size = wl->warehouse->size;
+	BOOLEAN private = wl->meta_info & 1;
+	int members = 1;
+	if (withPrev){
+		releaseID(wl_prev->warehouse->id);
+		unlinkWarehouseList(sf, wl_prev);
+		freeWarehouseList(wl_prev);
+		members++;
 	}
-	else{
-		if ((wl->next_warehouse) && !(wl->next_warehouse->meta_info & 2) && !((wl->meta_info & 1) ^ (wl->next_warehouse->meta_info & 1))){
-			if (wl_prev){
-				wl_prev->next_warehouse = wl->next_warehouse->next_warehouse;
-			}
-			else{
-				sf->warehouse_list_head = wl->next_warehouse->next_warehouse;
-			}
-			insertWarehouse( createWarehouse( wl->warehouse->id, wl->warehouse->size * 2), wl->meta_info & 1);
-			freeWarehouseList(wl->next_warehouse);
-			freeWarehouseList(wl);
-		}
+	if (withNext){
+		releaseID(wl_next->warehouse->id);
+		unlinkWarehouseList(sf, wl_next);
+		freeWarehouseList(wl_next);
+		members++;
 	}
+	unlinkWarehouseList(sf, wl);
+	freeWarehouseList(wl);
+	insertWarehouse( createWarehouse( id, size * members), private);
+	STATS_COUNT(STAT_COALESCED, members - 1);
+	STATS_STOP(timer, STAT_COALESCE);
+}
+
+/*
+ * fillWarehouse()
+ * stores an art collection in an unoccupied warehouse that is large enough, changing its allocated bit to 1
+ * clears its bit in the free bitmap of its class, adds it to the name index and the sorted views and counts it as occupied
+ *
+ * Params:
+ * 	sf
+ * 	the member of the sf list of which the warehouse is apart
+ *
+ * 	wl
+ * 	the warehouse to be filled
+ *
+ * 	art_collection
+ * 	the art collection to be stored
+ *
+ * Return:
+ * 	void
+ */
+void fillWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl, struct art_collection* art_collection){
+	removeFreeWarehouse(sf, wl);
+	wl->warehouse->art_collection = art_collection;
+	sf->arts[wl->slot] = art_collection;
+	wl->meta_info = wl->meta_info | 2;
+	utilization.occupied[wl->meta_info & 1]++;
+	utilization.art_size[wl->meta_info & 1] += art_collection->size;
+	indexArtCollection(wl);
+	addToSortedViews(wl);
 }
 
 /*
  * emptyWarehouse()
- * changes the emptying warehouse's allocated bit to 0 and calls coalesce()
+ * removes the art collection of the emptying warehouse from the utilization counters, the sorted views and the name index and frees it, changes its allocated bit to 0, marks it free again in the bitmap of its class and calls coalesce()
  *
  * Params:
- * 	sf, wl_prev_prev, wl_prev
- * 	for calling coalesce(), since they are found in the calling function
+ * 	sf
+ * 	the member of the sf list of which the warehouse is apart, for calling coalesce()
  *
  * 	wl
  * 	the warehouse to be emptied
@@ -429,45 +514,119 @@ void coalesce(struct warehouse_sf_list* sf, struct warehouse_list* wl_prev_prev,
  * Return:
  * 	void
  */
-void emptyWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl_prev_prev, struct warehouse_list* wl_prev, struct warehouse_list* wl){
+void emptyWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl){
+	struct art_collection* art_collection = wl->warehouse->art_collection;
+	if (art_collection){
+		utilization.occupied[wl->meta_info & 1]--;
+		utilization.art_size[wl->meta_info & 1] -= art_collection->size;
+		removeFromSortedViews(wl);
+		unindexArtCollection(wl);
+		freeArtCollection(art_collection);
+		wl->warehouse->art_collection = NULL;
+		sf->arts[wl->slot] = NULL;
+	}
 	wl->meta_info = wl->meta_info & -3;
-	coalesce(sf, wl_prev_prev, wl_prev, wl);
+	pushFreeWarehouse(sf, wl);
+	coalesce(sf, wl);
 }
 
 /***********************************************************************************************/
 
 /*
- * printUtilization()
- * prints two ratios
- * 	the ratio of occupied warehouses to the total number of warehouses 
- * 	the ratio of the total size of all art collections and the total capacity of all warehouses
+ * checkUtilization()
+ * debug builds only: recounts what the utilization counters hold from the bitmaps of every class and reports any mismatch to stderr
+ * the members are counted by popcount, and only the occupied ones (found by their bits) are visited for the size of their art
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+#ifdef DEBUG
+static void checkUtilization(){
+	struct utilization_counters scan;
+	struct warehouse_sf_list* sf_cursor;
+	int private;
+	memset(&scan, 0, sizeof(scan));
+	for (sf_cursor = sf_head; sf_cursor; sf_cursor = sf_cursor->sf_next_warehouse){
+		for (private=0; private<2; private++){
+			long occupied = countClassMembers(sf_cursor, private, TRUE);
+			long members = occupied + countClassMembers(sf_cursor, private, FALSE);
+			scan.warehouses[private] += members;
+			scan.occupied[private] += occupied;
+			scan.capacity[private] += members * sf_cursor->class_size;
+		}
+		uint32_t word;
+		for (word=0; word<(sf_cursor->slot_count + 63) / 64; word++){
+			for (private=0; private<2; private++){
+				uint64_t bits = occupiedSlots(sf_cursor, word, FALSE, private);
+				while (bits){
+					scan.art_size[private] += sf_cursor->arts[(word << 6) + __builtin_ctzll(bits)]->size;
+					bits &= bits - 1;
+				}
+			}
+		}
+	}
+	if (memcmp(&scan, &utilization, sizeof(scan)))
+		fprintf(stderr, "DEBUG: utilization counters out of sync with the database\n");
+}
+#endif
+
+/*
+ * getUtilization()
+ * computes the ratio of occupied warehouses to the total and the ratio of the total size of art collections to the total capacity
  *
  * Params:
- * 	void
+ * 	all, private
+ * 	which warehouses are counted, as for printUtilization()
+ *
+ * 	occupied, filled
+ * 	set to the two ratios
  *
  * Return:
  * 	void
  */
-void printUtilization(){
-	struct warehouse_sf_list* sf_cursor = sf_head;
-	struct warehouse_list* wl_cursor;
+void getUtilization(BOOLEAN all, BOOLEAN private, double* occupied, double* filled){
 	double numOccupied = 0;
 	double totalWarehouse = 0;
 	double totalArtSize = 0;
 	double warehouseCapacity = 0;
-	while(sf_cursor){
-		wl_cursor = sf_cursor->warehouse_list_head;
-		while(wl_cursor){
-			totalWarehouse++;
-			warehouseCapacity += wl_cursor->warehouse->size;
-			if (wl_cursor->meta_info & 2){
-				numOccupied++;
-				totalArtSize += wl_cursor->warehouse->art_collection->size;
-			}
-			wl_cursor = wl_cursor->next_warehouse;
+	int visibility;
+	for (visibility=0; visibility<2; visibility++){
+		if (all || visibility == (private & 1)){
+			numOccupied += utilization.occupied[visibility];
+			totalWarehouse += utilization.warehouses[visibility];
+			totalArtSize += utilization.art_size[visibility];
+			warehouseCapacity += utilization.capacity[visibility];
 		}
-		sf_cursor = sf_cursor->sf_next_warehouse;
 	}
-	printf("%f\n", numOccupied/totalWarehouse);
-	printf("%f\n", totalArtSize/warehouseCapacity);
+	*occupied = numOccupied/totalWarehouse;
+	*filled = totalArtSize/warehouseCapacity;
+}
+
+/*
+ * printUtilization()
+ * prints two ratios from the running utilization counters
+ * 	the ratio of occupied warehouses to the total number of warehouses 
+ * 	the ratio of the total size of all art collections and the total capacity of all warehouses
+ *
+ * Params:
+ * 	all
+ * 	TRUE if all warehouses are to be counted,  FALSE otherwise
+ *
+ * 	private
+ * 	TRUE if private warehouses are to be counted
+ * 	FALSE if public warehouses are to be counted
+ * 	overridden by all param
+ *
+ * Return:
+ * 	void
+ */
+void printUtilization(BOOLEAN all, BOOLEAN private){
+#ifdef DEBUG
+	checkUtilization();
+#endif
+	double occupied, filled;
+	getUtilization(all, private, &occupied, &filled);
+	outputFormat("%f\n", occupied);
+	outputFormat("%f\n", filled);
 }
@@ -0,0 +1,656 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * mapped_file
+ * The whole contents of a file being loaded, either memory mapped (read only) or, when the file can't be mapped, read into a buffer
+ */
+struct mapped_file {
+	const char* data;
+	size_t length;
+	BOOLEAN mapped;
+};
+
+/*
+ * token
+ * A field of a line, pointing straight into the mapped file (not NUL terminated)
+ */
+struct token {
+	const char* start;
+	size_t length;
+};
+
+/*
+ * mapFile()
+ * maps the contents of an opened file into memory, falling back on reading it into a buffer (e.g. for pipes or empty files)
+ *
+ * Params:
+ * 	file
+ * 	the opened file, read from its current position when it can't be mapped
+ *
+ * 	output
+ * 	set to the contents of the file
+ *
+ * Return:
+ * 	void
+ */
+static void mapFile(FILE* file, struct mapped_file* output){
+	struct stat info;
+	output->data = NULL;
+	output->length = 0;
+	output->mapped = FALSE;
+	if (!fstat(fileno(file), &info) && S_ISREG(info.st_mode) && info.st_size > 0 && !ftell(file)){
+		void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+		if (data != MAP_FAILED){
+			madvise(data, info.st_size, MADV_SEQUENTIAL);
+			output->data = data;
+			output->length = info.st_size;
+			output->mapped = TRUE;
+			return;
+		}
+	}
+	size_t capacity = 0;
+	size_t bytes;
+	char* buffer = NULL;
+	do {
+		if (output->length == capacity){
+			capacity = capacity ? capacity * 2 : 64 * 1024;
+			buffer = realloc(buffer, capacity);
+		}
+		bytes = fread(buffer + output->length, 1, capacity - output->length, file);
+		output->length += bytes;
+	} while (bytes);
+	output->data = buffer;
+}
+
+/*
+ * unmapFile()
+ * releases the contents of a file returned by mapFile()
+ *
+ * Params:
+ * 	file
+ * 	the contents to be released
+ *
+ * Return:
+ * 	void
+ */
+static void unmapFile(struct mapped_file* file){
+	if (file->mapped)
+		munmap((void*)file->data, file->length);
+	else
+		free((void*)file->data);
+}
+
+/*
+ * splitLine()
+ * splits a line into up to maxTokens fields by whitespace, in place, like commandSplitter() does for a line read into a buffer
+ * every field but the first can be put in quotes (i.e. "hello there") to keep it as one field
+ *
+ * Params:
+ * 	line, end
+ * 	the characters of the line, excluding its '\n'
+ *
+ * 	tokens
+ * 	array of at least maxTokens fields to be filled in
+ *
+ * 	maxTokens
+ * 	maximum amount of fields looked for, the rest of the line is ignored
+ *
+ * Return:
+ * 	number of fields found, -1 if a quote is never closed
+ */
+static int splitLine(const char* line, const char* end, struct token* tokens, int maxTokens){
+	int count = 0;
+	while (count < maxTokens){
+		while (line < end && isspace((unsigned char)*line))
+			line++;
+		if (line >= end)
+			break;
+		if (count && *line == '\"'){
+			const char* start = ++line;
+			while (line < end && *line != '\"')
+				line++;
+			if (line >= end)
+				return -1;
+			tokens[count].start = start;
+			tokens[count++].length = line++ - start;
+		}
+		else{
+			const char* start = line;
+			while (line < end && !isspace((unsigned char)*line))
+				line++;
+			tokens[count].start = start;
+			tokens[count++].length = line - start;
+		}
+	}
+	return count;
+}
+
+/*
+ * parseInt()
+ * converts a field to an integer the way atoi() does (leading whitespace, an optional sign, then digits up to the first non-digit)
+ *
+ * Params:
+ * 	token
+ * 	the field to be converted
+ *
+ * Return:
+ * 	its value, 0 if it doesn't start with a number
+ */
+static int parseInt(struct token* token){
+	const char* cursor = token->start;
+	const char* end = token->start + token->length;
+	BOOLEAN negative = FALSE;
+	unsigned int value = 0;
+	while (cursor < end && isspace((unsigned char)*cursor))
+		cursor++;
+	if (cursor < end && (*cursor == '-' || *cursor == '+'))
+		negative = (*cursor++ == '-');
+	while (cursor < end && (unsigned)(*cursor - '0') < 10)
+		value = value * 10 + (*cursor++ - '0');
+	return negative ? -(int)value : (int)value;
+}
+
+/*
+ * load_record
+ * One non-blank line of a file, parsed by a worker and waiting to be committed in file order
+ */
+struct load_record {
+	struct token name; // first field, kept as text for art files
+	int values[3]; // the fields converted with parseInt(), values[0] is unused for art files
+	int line; // line number within its chunk
+	BOOLEAN malformed;
+};
+
+/*
+ * load_chunk
+ * Range of whole lines of the file, parsed as a unit by one worker
+ */
+struct load_chunk {
+	const char* start;
+	const char* end;
+	struct load_record* records;
+	int count;
+	int lines;
+	BOOLEAN parsed;
+};
+
+/*
+ * load_job
+ * State shared between the workers parsing chunks and the committer inserting them in order
+ * Workers stay at most LOAD_WINDOW chunks ahead of the committer, so only that many chunks of records exist at once
+ */
+struct load_job {
+	struct load_chunk* chunks;
+	int chunkCount;
+	int nextChunk; // next chunk for a worker to parse
+	int committed; // number of chunks the committer is done with
+	BOOLEAN nameFirst;
+	pthread_mutex_t lock;
+	pthread_cond_t parsed;
+	pthread_cond_t room;
+};
+
+#define LOAD_CHUNK_BYTES (1024 * 1024)
+#define LOAD_WINDOW 16
+
+static int loaderThreads = 1;
+
+/*
+ * setLoaderThreads()
+ * sets how many worker threads parse the files being loaded
+ *
+ * Params:
+ * 	threads
+ * 	number of workers, 1 (or less) parses on the calling thread with no workers
+ *
+ * Return:
+ * 	void
+ */
+void setLoaderThreads(int threads){
+	loaderThreads = (threads < 1) ? 1 : threads;
+}
+
+/*
+ * parseChunk()
+ * splits every line of a chunk into fields and converts the numeric ones into its records
+ *
+ * Params:
+ * 	chunk
+ * 	the chunk to be parsed
+ *
+ * 	nameFirst
+ * 	TRUE if the first field is a name (art files), FALSE if it is a number (warehouse files)
+ *
+ * Return:
+ * 	void
+ */
+static void parseChunk(struct load_chunk* chunk, BOOLEAN nameFirst){
+	struct token tokens[3];
+	const char* line = chunk->start;
+	int capacity = 0;
+	chunk->records = NULL;
+	chunk->count = 0;
+	chunk->lines = 0;
+	while (line < chunk->end){
+		const char* lineEnd = memchr(line, '\n', chunk->end - line);
+		if (!lineEnd)
+			lineEnd = chunk->end;
+		chunk->lines++;
+		int count = splitLine(line, lineEnd, tokens, 3);
+		if (count){
+			if (chunk->count == capacity){
+				capacity = capacity ? capacity * 2 : 1024;
+				chunk->records = realloc(chunk->records, capacity * sizeof(struct load_record));
+			}
+			struct load_record* record = chunk->records + chunk->count++;
+			record->line = chunk->lines;
+			record->malformed = (count != 3);
+			if (!record->malformed){
+				record->name = tokens[0];
+				record->values[0] = nameFirst ? 0 : parseInt(tokens);
+				record->values[1] = parseInt(tokens + 1);
+				record->values[2] = parseInt(tokens + 2);
+			}
+		}
+		line = lineEnd + 1;
+	}
+}
+
+/*
+ * loadWorker()
+ * body of a worker thread: parses the next chunk of the job until there are none left
+ *
+ * Params:
+ * 	argument
+ * 	the load_job shared with the committer
+ *
+ * Return:
+ * 	NULL
+ */
+static void* loadWorker(void* argument){
+	struct load_job* job = argument;
+	pthread_mutex_lock(&job->lock);
+	while (1){
+		while (job->nextChunk < job->chunkCount && job->nextChunk >= job->committed + LOAD_WINDOW)
+			pthread_cond_wait(&job->room, &job->lock);
+		if (job->nextChunk >= job->chunkCount)
+			break;
+		struct load_chunk* chunk = job->chunks + job->nextChunk++;
+		pthread_mutex_unlock(&job->lock);
+		parseChunk(chunk, job->nameFirst);
+		pthread_mutex_lock(&job->lock);
+		chunk->parsed = TRUE;
+		pthread_cond_broadcast(&job->parsed);
+	}
+	pthread_mutex_unlock(&job->lock);
+	return NULL;
+}
+
+/*
+ * splitChunks()
+ * cuts the contents of a file into chunks of about LOAD_CHUNK_BYTES, each ending after a '\n'
+ *
+ * Params:
+ * 	contents
+ * 	the mapped file
+ *
+ * 	count
+ * 	set to the number of chunks
+ *
+ * Return:
+ * 	malloc'd array of the chunks
+ */
+static struct load_chunk* splitChunks(struct mapped_file* contents, int* count){
+	const char* cursor = contents->data;
+	const char* end = contents->data + contents->length;
+	int capacity = (int)(contents->length / LOAD_CHUNK_BYTES) + 1;
+	struct load_chunk* chunks = calloc(capacity, sizeof(struct load_chunk));
+	*count = 0;
+	while (cursor < end){
+		const char* chunkEnd = (end - cursor > LOAD_CHUNK_BYTES) ? cursor + LOAD_CHUNK_BYTES : end;
+		if (chunkEnd < end){
+			chunkEnd = memchr(chunkEnd, '\n', end - chunkEnd);
+			chunkEnd = chunkEnd ? chunkEnd + 1 : end;
+		}
+		if (*count == capacity){
+			capacity *= 2;
+			chunks = realloc(chunks, capacity * sizeof(struct load_chunk));
+		}
+		memset(chunks + *count, 0, sizeof(struct load_chunk));
+		chunks[*count].start = cursor;
+		chunks[(*count)++].end = chunkEnd;
+		cursor = chunkEnd;
+	}
+	return chunks;
+}
+
+/*
+ * loadFile()
+ * maps a file, parses its lines (on loaderThreads workers for files of more than one chunk) and commits them in file order
+ *
+ * Params:
+ * 	file
+ * 	pointer to the opened file to be read
+ *
+ * 	kind
+ * 	name of the kind of file, for error messages
+ *
+ * 	format
+ * 	the fields expected on each line, for error messages
+ *
+ * 	nameFirst
+ * 	TRUE if the first field is a name, FALSE if it is a number
+ *
+ * 	commit
+ * 	called with each well formed record, one at a time and in file order
+ *
+ * Return:
+ * 	void
+ */
+static void loadFile(FILE* file, const char* kind, const char* format, BOOLEAN nameFirst, void (*commit)(struct load_record* record)){
+	struct mapped_file contents;
+	struct load_job job;
+	mapFile(file, &contents);
+	job.chunks = splitChunks(&contents, &job.chunkCount);
+	job.nextChunk = 0;
+	job.committed = 0;
+	job.nameFirst = nameFirst;
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.parsed, NULL);
+	pthread_cond_init(&job.room, NULL);
+
+	// a single chunk or a single thread is parsed on this thread, as the committer goes
+	int workerCount = 0;
+	pthread_t* workers = NULL;
+	if (job.chunkCount > 1 && loaderThreads > 1){
+		workerCount = (loaderThreads < job.chunkCount) ? loaderThreads : job.chunkCount;
+		workers = malloc(workerCount * sizeof(pthread_t));
+	}
+	int i, j;
+	for (i=0; i<workerCount; i++)
+		pthread_create(workers + i, NULL, loadWorker, &job);
+
+	int lineBase = 0;
+	for (i=0; i<job.chunkCount; i++){
+		struct load_chunk* chunk = job.chunks + i;
+		if (workerCount){
+			pthread_mutex_lock(&job.lock);
+			while (!chunk->parsed)
+				pthread_cond_wait(&job.parsed, &job.lock);
+			pthread_mutex_unlock(&job.lock);
+		}
+		else
+			parseChunk(chunk, nameFirst);
+		for (j=0; j<chunk->count; j++){
+			if (chunk->records[j].malformed)
+				printError("line %d of the %s file is malformed, expected %s.\n", lineBase + chunk->records[j].line, kind, format);
+			else
+				commit(chunk->records + j);
+		}
+		lineBase += chunk->lines;
+		free(chunk->records);
+		if (workerCount){
+			pthread_mutex_lock(&job.lock);
+			job.committed = i + 1;
+			pthread_cond_broadcast(&job.room);
+			pthread_mutex_unlock(&job.lock);
+		}
+	}
+
+	for (i=0; i<workerCount; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+	pthread_mutex_destroy(&job.lock);
+	pthread_cond_destroy(&job.parsed);
+	pthread_cond_destroy(&job.room);
+	free(job.chunks);
+	unmapFile(&contents);
+}
+
+/***********************************************************************************************/
+
+/*
+ * commitWarehouse()
+ * creates and inserts the warehouse of one line of a warehouse file
+ *
+ * Params:
+ * 	record
+ * 	the parsed ID, SIZE and TYPE of the line
+ *
+ * Return:
+ * 	void
+ */
+static void commitWarehouse(struct load_record* record){
+	insertWarehouse( createWarehouse(record->values[0], record->values[1]), record->values[2]);
+}
+
+/*
+ * loadWarehouseFile()
+ * creates and inserts warehouses from file each specified by ID SIZE TYPE\n
+ *
+ * Params:
+ * 	warehouseFile
+ * 	pointer to the opened file to be read
+ *
+ * Return:
+ * 	void
+ */
+void loadWarehouseFile(FILE* warehouseFile){
+	loadFile(warehouseFile, "warehouse", "ID SIZE TYPE", FALSE, commitWarehouse);
+}
+
+/*
+ * commitArtCollection()
+ * creates and inserts the art collection of one line of an art file, its name interned straight from the mapped file
+ *
+ * Params:
+ * 	record
+ * 	the parsed NAME, SIZE and PRICE of the line
+ *
+ * Return:
+ * 	void
+ */
+static void commitArtCollection(struct load_record* record){
+	insertArtCollection( createArtCollectionFromName(record->name.start, record->name.length, record->values[1], record->values[2]));
+}
+
+/*
+ * loadArtFile()
+ * creates and inserts art collections from file each specified by NAME SIZE PRICE\n
+ *
+ * Params:
+ * 	artFile
+ * 	pointer to the opened file to be read
+ *
+ * Return:
+ * 	void
+ */
+void loadArtFile(FILE* artFile){
+	loadFile(artFile, "art", "NAME SIZE PRICE", TRUE, commitArtCollection);
+}
+
+/*
+ * bulk_item
+ * An art collection read by loadArtFileBulk(), whose name is kept at an offset of bulkLoad.names since
+ * the mapped file is gone (and the string table may be released by a restore) before it is placed
+ */
+struct bulk_item {
+	size_t name;
+	size_t length;
+	int size;
+	int price;
+	size_t index; // position in the file, so items of the same size keep their file order
+};
+
+static struct bulk_load {
+	struct bulk_item* items;
+	size_t count;
+	size_t capacity;
+	char* names;
+	size_t names_length;
+	size_t names_capacity;
+	struct art_collection** run; // art collections of the same size handed to insertArtCollectionRun() together
+	size_t run_capacity;
+} bulkLoad;
+
+/*
+ * collectArtCollection()
+ * keeps the art collection of one line of an art file for loadArtFileBulk() rather than placing it
+ *
+ * Params:
+ * 	record
+ * 	the parsed NAME, SIZE and PRICE of the line
+ *
+ * Return:
+ * 	void
+ */
+static void collectArtCollection(struct load_record* record){
+	if (bulkLoad.count == bulkLoad.capacity){
+		bulkLoad.capacity = bulkLoad.capacity ? bulkLoad.capacity * 2 : 1024;
+		bulkLoad.items = realloc(bulkLoad.items, bulkLoad.capacity * sizeof(struct bulk_item));
+	}
+	while (bulkLoad.names_length + record->name.length > bulkLoad.names_capacity){
+		bulkLoad.names_capacity = bulkLoad.names_capacity ? bulkLoad.names_capacity * 2 : 64 * 1024;
+		bulkLoad.names = realloc(bulkLoad.names, bulkLoad.names_capacity);
+	}
+	struct bulk_item* item = bulkLoad.items + bulkLoad.count;
+	memcpy(bulkLoad.names + bulkLoad.names_length, record->name.start, record->name.length);
+	item->name = bulkLoad.names_length;
+	item->length = record->name.length;
+	item->size = record->values[1];
+	item->price = record->values[2];
+	item->index = bulkLoad.count++;
+	bulkLoad.names_length += record->name.length;
+}
+
+/*
+ * compareBulkItems()
+ * qsort() order of loadArtFileBulk(): largest first, then in file order
+ */
+static int compareBulkItems(const void* a, const void* b){
+	const struct bulk_item* first = a;
+	const struct bulk_item* second = b;
+	if (first->size != second->size)
+		return (first->size < second->size) ? 1 : -1;
+	return (first->index > second->index) - (first->index < second->index);
+}
+
+/*
+ * placeBulkItems()
+ * inserts the collected art collections in their current order
+ *
+ * Params:
+ * 	runs
+ * 	TRUE to hand art collections of the same size that follow each other to insertArtCollectionRun() together, so they are split
+ * 	in bulk out of one warehouse, FALSE to insert them one at a time as loadArtFile() would
+ *
+ * Return:
+ * 	number of art collections that were stored
+ */
+static size_t placeBulkItems(BOOLEAN runs){
+	size_t placed = 0;
+	size_t i = 0;
+	while (i < bulkLoad.count){
+		size_t length = 0;
+		do {
+			struct bulk_item* item = bulkLoad.items + i++;
+			if (length == bulkLoad.run_capacity){
+				bulkLoad.run_capacity = bulkLoad.run_capacity ? bulkLoad.run_capacity * 2 : 256;
+				bulkLoad.run = realloc(bulkLoad.run, bulkLoad.run_capacity * sizeof(struct art_collection*));
+			}
+			bulkLoad.run[length++] = createArtCollectionFromName(bulkLoad.names + item->name, item->length, item->size, item->price);
+		} while (runs && i < bulkLoad.count && bulkLoad.items[i].size == bulkLoad.items[i - 1].size);
+		placed += insertArtCollectionRun(bulkLoad.run, length);
+	}
+	return placed;
+}
+
+/*
+ * freeBulkLoad()
+ * frees what loadArtFileBulk() collected and leaves it empty
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+static void freeBulkLoad(){
+	free(bulkLoad.items);
+	free(bulkLoad.names);
+	free(bulkLoad.run);
+	memset(&bulkLoad, 0, sizeof(bulkLoad));
+}
+
+/*
+ * loadArtFileBulk()
+ * reads a whole art file first, then places its art collections largest first (best fit decreasing), those of the same size split in bulk
+ * insertArtCollection() already picks the smallest class that fits, so placing the largest ones while the big
+ * warehouses are still whole leaves the small ones to the leftovers of the splits instead of the other way around
+ * to compare, the file is first placed in file order (as loadArtFile() would) on a copy of the database kept in a
+ * temporary snapshot, which is then restored; both results are reported. The errors of that pass are neither shown nor counted
+ *
+ * Params:
+ * 	artFile
+ * 	pointer to the opened file to be read
+ *
+ * 	compare
+ * 	TRUE to also place the file in file order and report the difference, FALSE to only report the bulk placement
+ *
+ * Return:
+ * 	void
+ */
+void loadArtFileBulk(FILE* artFile, BOOLEAN compare){
+	loadFile(artFile, "art", "NAME SIZE PRICE", TRUE, collectArtCollection);
+
+	size_t streamPlaced = 0;
+	double streamOccupied = 0, streamFilled = 0;
+	BOOLEAN compared = FALSE;
+	if (compare){
+		char snapshot[] = "/tmp/art_db_bulk_XXXXXX";
+		int fd = mkstemp(snapshot);
+		if (fd >= 0){
+			close(fd);
+			if (saveSnapshot(snapshot)){
+				int output = silenceOutput();
+				streamPlaced = placeBulkItems(FALSE);
+				getUtilization(TRUE, TRUE, &streamOccupied, &streamFilled);
+				restoreOutput(output);
+				if (!loadSnapshot(snapshot)){
+					printError("failed to restore the database, the art collections were placed in file order.\n");
+					remove(snapshot);
+					freeBulkLoad();
+					return;
+				}
+				compared = TRUE;
+			}
+			remove(snapshot);
+		}
+		if (!compared)
+			printError("failed to compare with placing in file order.\n");
+	}
+
+	qsort(bulkLoad.items, bulkLoad.count, sizeof(struct bulk_item), compareBulkItems);
+	size_t placed = placeBulkItems(TRUE);
+	double occupied, filled;
+	getUtilization(TRUE, TRUE, &occupied, &filled);
+	outputFormat("%zu art collection%s placed, %zu failed.\n", placed, (placed == 1) ? "" : "s", bulkLoad.count - placed);
+	if (compared){
+		outputFormat("In file order: %zu placed, %zu failed.\n", streamPlaced, bulkLoad.count - streamPlaced);
+		outputFormat("%f\t%f (in file order)\n", occupied, streamOccupied);
+		outputFormat("%f\t%f (in file order)\n", filled, streamFilled);
+	}
+	else
+		outputFormat("%f\n%f\n", occupied, filled);
+
+	freeBulkLoad();
+}
@@ -3,10 +3,13 @@
 #include <getopt.h>
 #include <ctype.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
 #include "warehouse.h"
 #define BOOLEAN char
 #define FALSE 0
 #define TRUE 1
+#define MAX_ARGS 7 // room for "range price 10 20 private > \"filename\""
 
 BOOLEAN equals(char* s1, char*s2){
 	return !strcmp(s1, s2);
@@ -15,17 +18,94 @@ BOOLEAN equals(char* s1, char*s2){
 BOOLEAN sizeSort = FALSE;
 BOOLEAN priceSort = FALSE;
 
-BOOLEAN executeCommand(char** args){
+/*
+ * parseNumber()
+ * reads an argument that must be a whole decimal int
+ *
+ * Params:
+ * 	arg
+ * 	the argument
+ *
+ * 	output
+ * 	where the int is stored
+ *
+ * Return:
+ * 	TRUE if the argument is an int, FALSE otherwise
+ */
+static BOOLEAN parseNumber(char* arg, int* output){
+	char* end;
+	errno = 0;
+	long value = strtol(arg, &end, 10);
+	if (end == arg || *end || errno || value < INT_MIN || value > INT_MAX)
+		return FALSE;
+	*output = value;
+	return TRUE;
+}
+
+/*
+ * redirectable()
+ *
+ * Params:
+ * 	command
+ * 	the first argument of a command
+ *
+ * Return:
+ * 	TRUE if what the command prints can be redirected to a file, FALSE otherwise
+ */
+static BOOLEAN redirectable(char* command){
+	return equals(command, "printall") || equals(command, "print") || equals(command, "find") || equals(command, "range") || equals(command, "top")
+		|| equals(command, "defrag");
+}
+
+/*
+ * dispatchCommand()
+ * executes one command of the shell (see executeCommand())
+ * an unquoted ">" followed by a file name at the end of the command redirects what it prints, and is taken off before the command is journaled
+ */
+static BOOLEAN dispatchCommand(char** args){
+	size_t i;
+	int count = 0;
+	while (args[count])
+		count++;
+	if (count >= 2 && equals(args[count - 1], ">") && !quotedArgument(args[count - 1]) && redirectable(*args)){
+		printError("no file specified\n");
+		return TRUE;
+	}
+	if (count >= 3 && equals(args[count - 2], ">") && !quotedArgument(args[count - 2])){
+		if (!redirectable(*args)){
+			printError("only printall, print, find, range, top and defrag can be redirected to a file.\n");
+			return TRUE;
+		}
+		if (!redirectOutput(args[count - 1]))
+			return TRUE;
+		args[count - 2] = NULL;
+	}
+	journalCommand(args);
 	if (equals(*args, "help")){
-		printf("help\t\t\t\tLists available commands.\n");
-		printf("load warehouse \"filename\"\tLoads into the database warehouses from a file.\n");
-		printf("load art \"filename\"\t\tLoads into the database art collections from a file.\n");
-		printf("printall\t\t\tPrints all the art collections of the database to stdout.\n");
-		printf("print public\t\t\tPrints all the art collections of the database in public warehouses to stdout.\n");
-		printf("print private\t\t\tPrints all the art collections of the database in private warehouses to stdout.\n");
-		printf("add art \"name\" \"size\" \"price\"\tEnters a new art collection in the database of a specified name, size, and price.\n");
-		printf("delete art \"name\"\t\tRemoves any art collections with the specified name from the database.\n");
-		printf("utilization\t\t\tPrints to stdout the ratio of occupied warehouses to the total and the ratio of the total size of art collections to\n\t\t\t\t\tthe total capacity of the warehouses.\n");
+		outputString("help\t\t\t\tLists available commands.\n");
+		outputString("load warehouse \"filename\"\tLoads into the database warehouses from a file.\n");
+		outputString("load art \"filename\"\t\tLoads into the database art collections from a file.\n");
+		outputString("load art \"filename\" bulk\tLoads art collections from a file largest first, and prints how many were placed and the utilization.\n");
+		outputString("load art \"filename\" bulk compare\tLoads the same way, and compares the result with loading them in file order.\n");
+		outputString("load snapshot \"filename\"\tReplaces the database by the one saved in a snapshot file.\n");
+		outputString("save \"filename\"\t\t\tSaves the whole database to a snapshot file.\n");
+		outputString("compact\t\t\t\tFolds the journal (-j \"filename\") into a snapshot of the database.\n");
+		outputString("printall\t\t\tPrints all the art collections of the database to stdout.\n");
+		outputString("print public\t\t\tPrints all the art collections of the database in public warehouses to stdout.\n");
+		outputString("print private\t\t\tPrints all the art collections of the database in private warehouses to stdout.\n");
+		outputString("add art \"name\" \"size\" \"price\"\tEnters a new art collection in the database of a specified name, size, and price.\n");
+		outputString("delete art \"name\"\t\tRemoves any art collections with the specified name from the database.\n");
+		outputString("find art \"name\"\t\t\tPrints all the art collections with the specified name to stdout.\n");
+		outputString("range size|price X Y\t\tPrints the art collections whose size (or price) is from X to Y, lowest first.\n");
+		outputString("range size|price X Y public|private\tPrints the same counting only public or only private warehouses.\n");
+		outputString("top size|price K\t\tPrints the K largest (or most expensive) art collections, highest first.\n");
+		outputString("top size|price K public|private\tPrints the same counting only public or only private warehouses.\n");
+		outputString("printall|print|find|range|top|defrag ... > \"filename\"\tWrites what the command prints to a file instead of stdout.\n");
+		outputString("views on|off\t\t\tKeeps (or stops keeping) the art collections sorted by size and price as the database changes.\n\t\t\t\t\tOff unless started with -v; range and top need them, the sorted prints only get faster.\n");
+		outputString("utilization\t\t\tPrints to stdout the ratio of occupied warehouses to the total and the ratio of the total size of art collections to\n\t\t\t\t\tthe total capacity of the warehouses.\n");
+		outputString("utilization public|private\tPrints the same ratios counting only public or only private warehouses.\n");
+		outputString("defrag\t\t\t\tMerges the unoccupied loaded warehouses of each visibility into one, printing the free space before and after.\n\t\t\t\t\tWithout it, they are only merged to make room after an art collection found no warehouse (up to -d merges a command).\n");
+		outputString("stats [on|off|reset]\t\tPrints (or starts, stops or zeroes) the call counts and times of the commands and core routines (builds with ART_DB_STATS only).\n");
 	}
 	else if (equals(*args, "load")){
 		if (equals(*++args, "warehouse")){
@@ -36,26 +116,45 @@ BOOLEAN executeCommand(char** args){
 					fclose(warehouseFile);
 				}
 				else{
-					printf("ERROR: failed to open %s\n", *args);
+					printError("failed to open %s\n", *args);
 				}
 			}
-			else printf("ERROR: no file specified\n");
+			else printError("no file specified\n");
 		}
 		else if (equals(*args,  "art")){
 			if (*++args) {
 				FILE* artFile = fopen(*args, "r");
 				if (artFile){
-					loadArtFile(artFile);
+					if (*(args + 1) && equals(*(args + 1), "bulk"))
+						loadArtFileBulk(artFile, *(args + 2) && equals(*(args + 2), "compare"));
+					else
+						loadArtFile(artFile);
 					fclose(artFile);
 				}
 				else{
-					printf("ERROR: failed to open %s\n", *args);
+					printError("failed to open %s\n", *args);
 				}
 			}
-			else printf("ERROR: no file specified\n");
+			else printError("no file specified\n");
+		}
+		else if (equals(*args, "snapshot")){
+			if (*++args)
+				loadSnapshot(*args);
+			else printError("no file specified\n");
 		}
 		else
-			printf("ERROR: not a valid command, type \"help\" for a list of commands.\n");
+			printError("not a valid command, type \"help\" for a list of commands.\n");
+	}
+	else if (equals(*args, "save")){
+		if (*++args)
+			saveSnapshot(*args);
+		else printError("no file specified\n");
+	}
+	else if (equals(*args, "compact")){
+		if (!journalOpen())
+			printError("there is no journal to compact, start with -j \"filename\".\n");
+		else
+			compactJournal();
 	}
 	else if (equals(*args, "printall")){
 		if (sizeSort){
@@ -69,7 +168,7 @@ BOOLEAN executeCommand(char** args){
 		}	
 	}
 	else if (equals(*args, "print")){
-		if (++args && equals(*args, "private") || equals(*args,  "public")){
+		if (*++args && (equals(*args, "private") || equals(*args,  "public"))){
 			BOOLEAN private = equals(*args, "private");
 			if (sizeSort){
 				printBySize(0, private);
@@ -82,7 +181,7 @@ BOOLEAN executeCommand(char** args){
 			}
 		}
 		else 
-			printf("ERROR: not a valid command, type \"help\" for a list of commands.\n");
+			printError("not a valid command, type \"help\" for a list of commands.\n");
 	}
 	else if (equals(*args, "add") && *(args + 1) && *(args + 2) && *(args + 3) && *(args + 4)){
 		if (equals(*++args, "art")){
@@ -91,89 +190,237 @@ BOOLEAN executeCommand(char** args){
 			int price = atoi(*++args);
 			struct art_collection* artC = createArtCollection(name, size, price);
 			insertArtCollection( artC );
+			defragStep();
 		}
 		else
-			printf("ERROR: not a valid command, type \"help\" for a list of commands.\n");
+			printError("not a valid command, type \"help\" for a list of commands.\n");
 	}
 	else if (equals(*args, "delete") && *(args + 1) && *(args + 2)){
 		if (equals(*++args, "art")){
 			args++;
-			int i;
 			for (i=0; i<strlen(*args); i++)
 				(*args)[i] = tolower((*args)[i]);
-			removeArtCollection(*args, 0);
+			removeArtCollection(*args);
+			defragStep();
 		}
 		else
-			printf("ERROR: not a valid command, type \"help\" for a list of commands.\n");
+			printError("not a valid command, type \"help\" for a list of commands.\n");
+	}
+	else if (equals(*args, "find") && *(args + 1) && *(args + 2)){
+		if (equals(*++args, "art")){
+			args++;
+			for (i=0; i<strlen(*args); i++)
+				(*args)[i] = tolower((*args)[i]);
+			findArtCollection(*args);
+		}
+		else
+			printError("not a valid command, type \"help\" for a list of commands.\n");
+	}
+	else if ((equals(*args, "range") || equals(*args, "top")) && *(args + 1) && *(args + 2)){
+		BOOLEAN range = equals(*args, "range");
+		char** visibility = args + (range ? 4 : 3);
+		int low, high;
+		if ((!equals(*(args + 1), "size") && !equals(*(args + 1), "price")) || !parseNumber(*(args + 2), &low)
+				|| (range && (!*(args + 3) || !parseNumber(*(args + 3), &high)))
+				|| (*visibility && ((!equals(*visibility, "public") && !equals(*visibility, "private")) || *(visibility + 1))))
+			printError("not a valid command, type \"help\" for a list of commands.\n");
+		else if (range)
+			printRange(!*visibility, *visibility && equals(*visibility, "private"), equals(*(args + 1), "size"), low, high);
+		else
+			printTop(!*visibility, *visibility && equals(*visibility, "private"), equals(*(args + 1), "size"), low);
+	}
+	else if (equals(*args, "views")){
+		if (*(args + 1) && equals(*(args + 1), "on"))
+			setSortedViews(TRUE);
+		else if (*(args + 1) && equals(*(args + 1), "off"))
+			setSortedViews(FALSE);
+		else if (!*(args + 1))
+			outputFormat("views are %s\n", sortedViewsEnabled() ? "on" : "off");
+		else
+			printError("not a valid command, type \"help\" for a list of commands.\n");
+	}
+	else if (equals(*args, "defrag")){
+		if (!*(args + 1))
+			defragment();
+		else
+			printError("not a valid command, type \"help\" for a list of commands.\n");
+	}
+	else if (equals(*args, "stats")){
+		if (!*(args + 1))
+			printStats();
+		else if (equals(*(args + 1), "on") || equals(*(args + 1), "off"))
+			setStats(equals(*(args + 1), "on"));
+		else if (equals(*(args + 1), "reset"))
+			resetStats();
+		else
+			printError("not a valid command, type \"help\" for a list of commands.\n");
 	}
 	else if (equals(*args, "utilization")){
-		printUtilization();
+		if (!*(args + 1))
+			printUtilization(1, 1);
+		else if (equals(*(args + 1), "private") || equals(*(args + 1), "public"))
+			printUtilization(0, equals(*(args + 1), "private"));
+		else
+			printError("not a valid command, type \"help\" for a list of commands.\n");
 	}
 	else if (equals(*args, "exit")){
 		return FALSE;
 	}
 	else{
-		printf("ERROR: not a valid command, type \"help\" for a list of commands.\n");
+		printError("not a valid command, type \"help\" for a list of commands.\n");
 	}
+	flushOutput();
+	endRedirect();
 	return TRUE;
 }
 
+/*
+ * executeCommand()
+ * executes one command of the shell, timed for the stats command, then lets the journal sync its group or compact (see journalTick())
+ *
+ * Params:
+ * 	args
+ * 	list of string pointers for each argument
+ *
+ * Return:
+ * 	TRUE if shell should keep executing
+ * 	FALSE if shell should terminate
+ */
+BOOLEAN executeCommand(char** args){
+	STATS_START(timer);
+	BOOLEAN keepGoing = dispatchCommand(args);
+	journalTick();
+	STATS_STOP(timer, statsCommand(*args));
+	return keepGoing;
+}
+
+#ifndef ART_DB_NO_MAIN // defined when the database is linked into another program, e.g. bench/bench.c
 int main(int argc, char** argv) {
 	sf_head = NULL;
+	atexit(flushOutput); // errors printed before an exit(1) are still in the buffer of output.c
 	BOOLEAN quiet = FALSE;
-	FILE* warehouseFile;
-	FILE* artFile;
+	BOOLEAN bulk = FALSE;
+	BOOLEAN stopOnError = FALSE;
+	FILE* batchFile = NULL;
+	int status = 0;
+	FILE* warehouseFile = NULL;
+	FILE* artFile = NULL;
+	char* warehouseName = NULL;
+	char* artName = NULL;
+	char* snapshotFile = NULL;
+	char* journalFile = NULL;
+	int budget;
+	int threads;
 	int opt;
-	while ((opt = getopt(argc, argv, "qw:a:s:")) != -1){
+	while ((opt = getopt(argc, argv, "qBvw:a:r:j:b:es:t:d:")) != -1){
 		switch (opt){
 			case 'q':
 				quiet = TRUE;
 				break;
 			case 'w':
 				if (!quiet){
-					printf("ERROR: warehouses files can only be opened by commandline when in quiet mode (-q).\n");
+					printError("warehouses files can only be opened by commandline when in quiet mode (-q).\n");
 					exit(1);
 				}
+				warehouseName = optarg;
 				warehouseFile = fopen(optarg, "r");
 				if (!warehouseFile){
-					printf("ERROR: failed to open Warehouses File \"%s\".\n", optarg);
+					printError("failed to open Warehouses File \"%s\".\n", optarg);
 					exit(1);
 				}
 				break;
 			case 'a':
 				if (!quiet){
-					printf("ERROR: art collections files can only be opened by commandline when in quiet mode (-q).\n");
+					printError("art collections files can only be opened by commandline when in quiet mode (-q).\n");
 					exit(1);
 				}
+				artName = optarg;
 				artFile = fopen(optarg, "r");
 				if (!artFile){
-					printf("ERROR: failed to open Art Collections File \"%s\".\n", optarg);
+					printError("failed to open Art Collections File \"%s\".\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'B':
+				bulk = TRUE;
+				break;
+			case 'v':
+				setSortedViews(TRUE);
+				break;
+			case 'b':
+				batchFile = equals(optarg, "-") ? stdin : fopen(optarg, "r");
+				if (!batchFile){
+					printError("failed to open the script \"%s\".\n", optarg);
 					exit(1);
 				}
 				break;
+			case 'e':
+				stopOnError = TRUE;
+				break;
+			case 'r':
+			      snapshotFile = optarg;
+			      break;
+			case 'j':
+			      journalFile = optarg;
+			      break;
 			case 's':
 			      if (optarg[0] == 's' && optarg[1] == '\0')
 				      sizeSort = TRUE;
 			      else if (optarg[0] == 'p' && optarg[1] == '\0')
 				      priceSort = TRUE;
 			      else{
-				      printf("ERROR: \"%s\" is not a valid argument for -s. Valid arguments: \"p\" and \"s\".\n", optarg);
+				      printError("\"%s\" is not a valid argument for -s. Valid arguments: \"p\" and \"s\".\n", optarg);
 				      exit(1);
 			      }
 			      break;
+			case 't':
+			      if (!parseNumber(optarg, &threads) || threads < 1){
+				      printError("\"%s\" is not a valid argument for -t. It must be a positive number of loader threads.\n", optarg);
+				      exit(1);
+			      }
+			      setLoaderThreads(threads);
+			      break;
+			case 'd':
+			      if (!parseNumber(optarg, &budget) || budget < 0){
+				      printError("\"%s\" is not a valid argument for -d. It must be a number of merges per command.\n", optarg);
+				      exit(1);
+			      }
+			      setDefragBudget(budget);
+			      break;
 			case '?':
 			      exit(1);
 		}
 	}
-	if (quiet && (!warehouseFile || !artFile)){
-		printf("ERROR: no Query Provided. Quiet mode needs both a warehouse file (-w \"filename\") and an art file (-a \"filename\")\n");
+	if (quiet && !snapshotFile && (!warehouseFile || !artFile)){
+		printError("no Query Provided. Quiet mode needs both a warehouse file (-w \"filename\") and an art file (-a \"filename\"), or a snapshot (-r \"filename\")\n");
 		exit(1);
 	}
+	if (quiet && batchFile){
+		printError("a script (-b \"filename\") can't be run in quiet mode (-q).\n");
+		exit(1);
+	}
+	if (snapshotFile && !loadSnapshot(snapshotFile))
+		exit(1);
+	if (journalFile && !openJournal(journalFile))
+		exit(1);
 	if (quiet){	
-		loadWarehouseFile(warehouseFile);
-		fclose(warehouseFile);
-		loadArtFile(artFile);
-		fclose(artFile);
+		// journaled as the load commands they stand for, so a crash before the first compaction replays them too
+		if (warehouseFile){
+			char* load[] = { "load", "warehouse", warehouseName, NULL };
+			journalCommand(load);
+			loadWarehouseFile(warehouseFile);
+			fclose(warehouseFile);
+		}
+		if (artFile){
+			char* load[] = { "load", "art", artName, bulk ? "bulk" : NULL, NULL };
+			journalCommand(load);
+			if (bulk)
+				loadArtFileBulk(artFile, FALSE);
+			else
+				loadArtFile(artFile);
+			fclose(artFile);
+		}
+		journalTick();
 		if (sizeSort){
 			printBySize(1, 1);
 		}
@@ -183,11 +430,22 @@ int main(int argc, char** argv) {
 		else{
 			printUnsorted(1, 1);
 		}	
+		flushOutput();
+	}
+	else if (batchFile){
+		BOOLEAN completed = runBatch(batchFile, MAX_ARGS, stopOnError);
+		if (batchFile != stdin)
+			fclose(batchFile);
+		if (!completed)
+			status = 1;
 	}
 	else
-		shell_loop(5);
+		shell_loop(MAX_ARGS);
 
-	printf("DONE.\n");
+	outputString("DONE.\n");
+	flushOutput();
+	closeJournal();
 	freeAllWarehouseSFList();
-	return 0;
+	return status;
 }
+#endif /* ART_DB_NO_MAIN */
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * name_entry
+ * All the occupied warehouses holding an art collection of one name, linked through their next_same_name/prev_same_name
+ * The entry keeps its own copy of the name, so it never depends on the art collection it was made for still being there
+ */
+struct name_entry {
+	uint32_t hash;
+	int count;
+	struct warehouse_list* head;
+	char name[]; // allocated with the entry
+};
+
+/*
+ * name_index
+ * Open addressing (linear probing) hash table of name entries, keyed by art collection name
+ * An entry is removed as soon as its last warehouse is emptied
+ * Only occupied warehouses are in the index, so coalescing and splitting (which only touch unoccupied ones) never update it
+ */
+struct name_index {
+	struct name_entry** slots;
+	size_t capacity;
+	size_t count;
+};
+
+static struct name_index nameIndex = { NULL, 0, 0 };
+
+/*
+ * hashName()
+ * FNV-1a hash of a name
+ *
+ * Params:
+ * 	name
+ * 	the string to be hashed
+ *
+ * Return:
+ * 	32 bit hash of name
+ */
+static uint32_t hashName(char* name){
+	uint32_t hash = 2166136261u;
+	while (*name){
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * findSlot()
+ * finds the slot holding the entry of a name, or the empty slot ending its probe run
+ *
+ * Params:
+ * 	name, hash
+ * 	the name looked for and its hash
+ *
+ * Return:
+ * 	index of the slot
+ */
+static size_t findSlot(char* name, uint32_t hash){
+	size_t mask = nameIndex.capacity - 1;
+	size_t slot = hash & mask;
+	while (nameIndex.slots[slot]){
+		if (nameIndex.slots[slot]->hash == hash && !strcmp(nameIndex.slots[slot]->name, name))
+			break;
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+/*
+ * growNameIndex()
+ * doubles the capacity of the index (or makes its first allocation) and rehashes every entry
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+static void growNameIndex(){
+	struct name_entry** oldSlots = nameIndex.slots;
+	size_t oldCapacity = nameIndex.capacity;
+	size_t i;
+
+	nameIndex.capacity = oldCapacity ? oldCapacity * 2 : 64;
+	nameIndex.slots = calloc(nameIndex.capacity, sizeof(struct name_entry*));
+	for (i=0; i<oldCapacity; i++){
+		if (oldSlots[i]){
+			size_t slot = oldSlots[i]->hash & (nameIndex.capacity - 1);
+			while (nameIndex.slots[slot])
+				slot = (slot + 1) & (nameIndex.capacity - 1);
+			nameIndex.slots[slot] = oldSlots[i];
+		}
+	}
+	free(oldSlots);
+}
+
+/*
+ * removeSlot()
+ * frees the entry of a slot and shifts back any entries of the same probe run so lookups need no tombstones
+ *
+ * Params:
+ * 	hole
+ * 	index of the slot to be emptied
+ *
+ * Return:
+ * 	void
+ */
+static void removeSlot(size_t hole){
+	size_t mask = nameIndex.capacity - 1;
+	size_t cursor = hole;
+	free(nameIndex.slots[hole]);
+	while (1){
+		cursor = (cursor + 1) & mask;
+		if (!nameIndex.slots[cursor])
+			break;
+		size_t home = nameIndex.slots[cursor]->hash & mask;
+		// the entry can fill the hole only if its home slot is not cyclically within (hole, cursor]
+		if (((cursor - home) & mask) >= ((cursor - hole) & mask)){
+			nameIndex.slots[hole] = nameIndex.slots[cursor];
+			hole = cursor;
+		}
+	}
+	nameIndex.slots[hole] = NULL;
+	nameIndex.count--;
+}
+
+/*
+ * indexArtCollection()
+ * adds a warehouse that was just filled to the entry of its art collection's name
+ *
+ * Params:
+ * 	wl
+ * 	the occupied warehouse list member
+ *
+ * Return:
+ * 	void
+ */
+void indexArtCollection(struct warehouse_list* wl){
+	if ((nameIndex.count + 1) * 4 > nameIndex.capacity * 3)
+		growNameIndex();
+	char* name = wl->warehouse->art_collection->name;
+	uint32_t hash = hashName(name);
+	size_t slot = findSlot(name, hash);
+	struct name_entry* entry = nameIndex.slots[slot];
+	if (!entry){
+		size_t length = strlen(name);
+		entry = malloc(sizeof(struct name_entry) + length + 1);
+		memcpy(entry->name, name, length + 1);
+		entry->hash = hash;
+		entry->count = 0;
+		entry->head = NULL;
+		nameIndex.slots[slot] = entry;
+		nameIndex.count++;
+	}
+	wl->prev_same_name = NULL;
+	wl->next_same_name = entry->head;
+	if (entry->head)
+		entry->head->prev_same_name = wl;
+	entry->head = wl;
+	entry->count++;
+}
+
+/*
+ * unindexArtCollection()
+ * removes a warehouse that is being emptied from the entry of its art collection's name
+ *
+ * Params:
+ * 	wl
+ * 	the occupied warehouse list member, whose art collection is still attached
+ *
+ * Return:
+ * 	void
+ */
+void unindexArtCollection(struct warehouse_list* wl){
+	if (!nameIndex.count)
+		return;
+	char* name = wl->warehouse->art_collection->name;
+	size_t slot = findSlot(name, hashName(name));
+	struct name_entry* entry = nameIndex.slots[slot];
+	if (!entry)
+		return;
+	if (wl->prev_same_name)
+		wl->prev_same_name->next_same_name = wl->next_same_name;
+	else
+		entry->head = wl->next_same_name;
+	if (wl->next_same_name)
+		wl->next_same_name->prev_same_name = wl->prev_same_name;
+	wl->next_same_name = NULL;
+	wl->prev_same_name = NULL;
+	if (!--entry->count)
+		removeSlot(slot);
+}
+
+/*
+ * compareDatabaseOrder()
+ * qsort() comparator putting warehouse list members in the order a walk from sf_head meets them
+ * classes are walked smallest first, and members of a class list are in increasing order of their sequence
+ */
+static int compareDatabaseOrder(const void* a, const void* b){
+	struct warehouse_list* wl_a = *(struct warehouse_list**)a;
+	struct warehouse_list* wl_b = *(struct warehouse_list**)b;
+	if (wl_a->warehouse->size != wl_b->warehouse->size)
+		return (wl_a->warehouse->size < wl_b->warehouse->size) ? -1 : 1;
+	if (wl_a->sequence != wl_b->sequence)
+		return (wl_a->sequence < wl_b->sequence) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * gatherArtCollections()
+ * looks up every occupied warehouse holding an art collection of the specified name
+ *
+ * Params:
+ * 	name
+ * 	the lowercase name looked for
+ *
+ * 	count
+ * 	set to the number of warehouses found
+ *
+ * Return:
+ * 	malloc'd array of the warehouse list members found, in the order a walk of the database would meet them
+ * 	NULL if there are none
+ */
+struct warehouse_list** gatherArtCollections(char* name, int* count){
+	*count = 0;
+	if (!nameIndex.count)
+		return NULL;
+	struct name_entry* entry = nameIndex.slots[findSlot(name, hashName(name))];
+	if (!entry)
+		return NULL;
+	struct warehouse_list** output = malloc(entry->count * sizeof(struct warehouse_list*));
+	struct warehouse_list* cursor;
+	for (cursor = entry->head; cursor; cursor = cursor->next_same_name)
+		output[(*count)++] = cursor;
+	STATS_COUNT(STAT_NODES_TRAVERSED, *count);
+	qsort(output, *count, sizeof(struct warehouse_list*), compareDatabaseOrder);
+	return output;
+}
+
+/*
+ * freeNameIndex()
+ * frees every entry of the name index and leaves it empty
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void freeNameIndex(){
+	size_t i;
+	for (i=0; i<nameIndex.capacity; i++){
+		if (nameIndex.slots[i])
+			free(nameIndex.slots[i]);
+	}
+	free(nameIndex.slots);
+	nameIndex.slots = NULL;
+	nameIndex.capacity = 0;
+	nameIndex.count = 0;
+}
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * output
+ * Buffer of everything the commands print, written with write() a whole buffer at a time instead of a printf() per row
+ * Rows go to stdout, or to the file a command was redirected to ("printall > \"out.txt\"")
+ * Nothing is printed to stdout through stdio, so what is printed stays in order without flushing it; errors go through here as well (see outputError())
+ */
+#define OUTPUT_BUFFER_BYTES (256 * 1024)
+
+static struct output {
+	int fd;
+	char* file_name; // of the redirection, NULL while writing to stdout
+	BOOLEAN failed; // a write failed, reported once by endRedirect() or flushOutput()
+	size_t length;
+	char buffer[OUTPUT_BUFFER_BYTES];
+} output = { STDOUT_FILENO, NULL, FALSE, 0, { 0 } };
+
+/*
+ * writeAll()
+ * writes characters to a descriptor, as many write()s as it takes
+ *
+ * Params:
+ * 	fd
+ * 	the descriptor written to
+ *
+ * 	data, length
+ * 	the characters to be written
+ *
+ * Return:
+ * 	TRUE if they were all written, FALSE if a write failed
+ */
+static BOOLEAN writeAll(int fd, const char* data, size_t length){
+	while (length){
+		ssize_t written = write(fd, data, length);
+		if (written <= 0)
+			return FALSE;
+		data += written;
+		length -= written;
+	}
+	return TRUE;
+}
+
+/*
+ * writeBuffer()
+ * writes the whole buffer out and empties it
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+static void writeBuffer(){
+	if (!output.failed && !writeAll(output.fd, output.buffer, output.length))
+		output.failed = TRUE;
+	output.length = 0;
+}
+
+/*
+ * outputBytes()
+ * appends characters to the buffer, writing it out whenever it fills up
+ *
+ * Params:
+ * 	data, length
+ * 	the characters to be printed
+ *
+ * Return:
+ * 	void
+ */
+void outputBytes(const char* data, size_t length){
+	while (output.length + length > OUTPUT_BUFFER_BYTES){
+		size_t room = OUTPUT_BUFFER_BYTES - output.length;
+		memcpy(output.buffer + output.length, data, room);
+		output.length += room;
+		data += room;
+		length -= room;
+		writeBuffer();
+	}
+	memcpy(output.buffer + output.length, data, length);
+	output.length += length;
+}
+
+/*
+ * outputString()
+ * appends a NUL terminated string to the buffer
+ *
+ * Params:
+ * 	string
+ * 	the string to be printed
+ *
+ * Return:
+ * 	void
+ */
+void outputString(const char* string){
+	outputBytes(string, strlen(string));
+}
+
+/*
+ * formatText()
+ * formats a message as vsnprintf() would into a newly allocated string
+ *
+ * Params:
+ * 	format, arguments
+ * 	as for vprintf()
+ *
+ * 	length
+ * 	set to the length of the string
+ *
+ * Return:
+ * 	the string, to be free()'d, NULL if the format is invalid
+ */
+static char* formatText(const char* format, va_list arguments, int* length){
+	va_list copy;
+	va_copy(copy, arguments);
+	*length = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
+	if (*length < 0)
+		return NULL;
+	char* text = malloc(*length + 1);
+	vsnprintf(text, *length + 1, format, arguments);
+	return text;
+}
+
+/*
+ * outputFormat()
+ * appends a message formatted as by printf() to the buffer, straight into it when it has room
+ * meant for the few lines of the commands that report (utilization, stats, ...), the rows of the print commands having faster calls
+ *
+ * Params:
+ * 	format, ...
+ * 	as for printf()
+ *
+ * Return:
+ * 	void
+ */
+void outputFormat(const char* format, ...){
+	va_list arguments;
+	va_start(arguments, format);
+	size_t room = OUTPUT_BUFFER_BYTES - output.length;
+	va_list copy;
+	va_copy(copy, arguments);
+	int length = vsnprintf(output.buffer + output.length, room, format, copy);
+	va_end(copy);
+	if (length >= 0 && (size_t)length < room)
+		output.length += length;
+	else{
+		char* text = formatText(format, arguments, &length);
+		if (text)
+			outputBytes(text, length);
+		free(text);
+	}
+	va_end(arguments);
+}
+
+/*
+ * outputError()
+ * prints an error message prefixed by "ERROR: " to stdout, through the buffer, or at once if output is redirected to a file
+ * so that it is seen instead of landing in the file
+ *
+ * Params:
+ * 	format, arguments
+ * 	as for vprintf()
+ *
+ * Return:
+ * 	void
+ */
+void outputError(const char* format, va_list arguments){
+	int length;
+	char* text = formatText(format, arguments, &length);
+	if (!text)
+		return;
+	if (!output.file_name){
+		outputString("ERROR: ");
+		outputBytes(text, length);
+	}
+	else if (!writeAll(STDOUT_FILENO, "ERROR: ", 7) || !writeAll(STDOUT_FILENO, text, length))
+		output.failed = TRUE;
+	free(text);
+}
+
+/*
+ * outputInt()
+ * appends the decimal form of an int to the buffer, formatted by hand rather than through printf()
+ *
+ * Params:
+ * 	value
+ * 	the int to be printed
+ *
+ * Return:
+ * 	void
+ */
+void outputInt(int value){
+	char digits[12];
+	char* cursor = digits + sizeof(digits);
+	unsigned int magnitude = (value < 0) ? 0u - (unsigned int)value : (unsigned int)value;
+	do {
+		*--cursor = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while (magnitude);
+	if (value < 0)
+		*--cursor = '-';
+	outputBytes(cursor, digits + sizeof(digits) - cursor);
+}
+
+/*
+ * flushOutput()
+ * writes out whatever is left in the buffer, at the end of every command that printed to it
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void flushOutput(){
+	if (output.length)
+		writeBuffer();
+	if (output.failed && !output.file_name){
+		output.failed = FALSE;
+		printError("failed to write to stdout\n");
+	}
+}
+
+/*
+ * redirectOutput()
+ * sends what is printed through the buffer to a file (created or truncated) until endRedirect()
+ *
+ * Params:
+ * 	fileName
+ * 	path of the file to be written
+ *
+ * Return:
+ * 	TRUE if the file was opened
+ */
+BOOLEAN redirectOutput(char* fileName){
+	flushOutput();
+	int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0){
+		printError("failed to open %s\n", fileName);
+		return FALSE;
+	}
+	output.fd = fd;
+	output.file_name = fileName;
+	return TRUE;
+}
+
+/*
+ * endRedirect()
+ * writes out and closes the file output was redirected to, then goes back to stdout
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void endRedirect(){
+	if (!output.file_name)
+		return;
+	flushOutput();
+	if (close(output.fd) || output.failed)
+		printError("failed to write %s\n", output.file_name);
+	output.fd = STDOUT_FILENO;
+	output.file_name = NULL;
+	output.failed = FALSE;
+}
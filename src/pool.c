@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+#define SLAB_BYTES (64 * 1024)
+
+/*
+ * slab
+ * Header of one block of memory a pool or the string table carves objects out of
+ */
+struct slab {
+	struct slab* next;
+};
+
+/*
+ * The pools of the five structs of the database, released all at once by freeAllWarehouseSFList()
+ */
+struct pool warehousePool = { sizeof(struct warehouse), NULL, NULL, NULL, NULL };
+struct pool warehouseListPool = { sizeof(struct warehouse_list), NULL, NULL, NULL, NULL };
+struct pool warehouseSFListPool = { sizeof(struct warehouse_sf_list), NULL, NULL, NULL, NULL };
+struct pool artCollectionPool = { sizeof(struct art_collection), NULL, NULL, NULL, NULL };
+struct pool warehouseSplitPool = { sizeof(struct warehouse_split), NULL, NULL, NULL, NULL };
+
+/*
+ * poolObjectSize()
+ * size of the objects of a pool, rounded up so every object is aligned and can hold the link of the free list
+ *
+ * Params:
+ * 	pool
+ * 	the pool
+ *
+ * Return:
+ * 	size in bytes of each object carved out of its slabs
+ */
+static size_t poolObjectSize(struct pool* pool){
+	size_t size = pool->object_size < sizeof(void*) ? sizeof(void*) : pool->object_size;
+	return (size + 7) & ~(size_t)7;
+}
+
+/*
+ * poolAlloc()
+ * takes an object from a pool, reusing a freed one if there is any, otherwise carving it from the current slab
+ *
+ * Params:
+ * 	pool
+ * 	the pool to allocate from
+ *
+ * Return:
+ * 	pointer to the (uninitialized) object
+ */
+void* poolAlloc(struct pool* pool){
+	if (pool->free_list){
+		void* output = pool->free_list;
+		pool->free_list = *(void**)output;
+		return output;
+	}
+	size_t size = poolObjectSize(pool);
+	if (!pool->next || pool->next + size > pool->end){
+		struct slab* slab = malloc(SLAB_BYTES);
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+		pool->next = (char*)slab + ((sizeof(struct slab) + 7) & ~(size_t)7);
+		pool->end = (char*)slab + SLAB_BYTES;
+	}
+	void* output = pool->next;
+	pool->next += size;
+	return output;
+}
+
+/*
+ * poolFree()
+ * gives an object back to its pool, to be reused by the next poolAlloc()
+ *
+ * Params:
+ * 	pool
+ * 	the pool the object was allocated from
+ *
+ * 	object
+ * 	the object to be freed
+ *
+ * Return:
+ * 	void
+ */
+void poolFree(struct pool* pool, void* object){
+	*(void**)object = pool->free_list;
+	pool->free_list = object;
+}
+
+/*
+ * poolRelease()
+ * frees every slab of a pool at once, invalidating every object allocated from it, and leaves it empty
+ *
+ * Params:
+ * 	pool
+ * 	the pool to be released
+ *
+ * Return:
+ * 	void
+ */
+void poolRelease(struct pool* pool){
+	struct slab* cursor = pool->slabs;
+	struct slab* temp;
+	while (cursor){
+		temp = cursor;
+		cursor = cursor->next;
+		free(temp);
+	}
+	pool->slabs = NULL;
+	pool->free_list = NULL;
+	pool->next = NULL;
+	pool->end = NULL;
+}
+
+/***********************************************************************************************/
+
+/*
+ * string_table
+ * Interned art collection names: each distinct (lowercase) name is stored once, in arena slabs that are only freed all together
+ * Lookups go through an open addressing (linear probing) hash set of the stored names
+ */
+struct string_table {
+	char** slots;
+	uint32_t* hashes;
+	size_t capacity;
+	size_t count;
+	struct slab* slabs;
+	char* next;
+	char* end;
+};
+
+static struct string_table stringTable = { NULL, NULL, 0, 0, NULL, NULL, NULL };
+
+/*
+ * hashLowercase()
+ * FNV-1a hash of the lowercase version of a string, the same hash hashName() in name_index.c gives the lowercase string itself
+ *
+ * Params:
+ * 	string, length
+ * 	the characters to be hashed
+ *
+ * Return:
+ * 	32 bit hash
+ */
+static uint32_t hashLowercase(const char* string, size_t length){
+	uint32_t hash = 2166136261u;
+	size_t i;
+	for (i=0; i<length; i++){
+		hash ^= (unsigned char)tolower((unsigned char)string[i]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * equalsLowercase()
+ * compares an interned name against the lowercase version of a string
+ *
+ * Params:
+ * 	interned
+ * 	the stored (lowercase) name
+ *
+ * 	string, length
+ * 	the characters compared against it
+ *
+ * Return:
+ * 	TRUE if they are the same name, FALSE otherwise
+ */
+static BOOLEAN equalsLowercase(const char* interned, const char* string, size_t length){
+	size_t i;
+	for (i=0; i<length; i++)
+		if (interned[i] != tolower((unsigned char)string[i]))
+			return FALSE;
+	return interned[length] == '\0';
+}
+
+/*
+ * arenaCopyLowercase()
+ * copies the lowercase version of a string into the arena of the string table
+ *
+ * Params:
+ * 	string, length
+ * 	the characters to be copied
+ *
+ * Return:
+ * 	pointer to the NUL terminated copy
+ */
+static char* arenaCopyLowercase(const char* string, size_t length){
+	size_t header = (sizeof(struct slab) + 7) & ~(size_t)7;
+	if (!stringTable.next || stringTable.next + length + 1 > stringTable.end){
+		size_t bytes = (header + length + 1 > SLAB_BYTES) ? header + length + 1 : SLAB_BYTES;
+		struct slab* slab = malloc(bytes);
+		slab->next = stringTable.slabs;
+		stringTable.slabs = slab;
+		stringTable.next = (char*)slab + header;
+		stringTable.end = (char*)slab + bytes;
+	}
+	char* output = stringTable.next;
+	size_t i;
+	for (i=0; i<length; i++)
+		output[i] = tolower((unsigned char)string[i]);
+	output[length] = '\0';
+	stringTable.next += length + 1;
+	return output;
+}
+
+/*
+ * growStringTable()
+ * doubles the capacity of the hash set (or makes its first allocation) and rehashes every name
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+static void growStringTable(){
+	char** oldSlots = stringTable.slots;
+	uint32_t* oldHashes = stringTable.hashes;
+	size_t oldCapacity = stringTable.capacity;
+	size_t i;
+
+	stringTable.capacity = oldCapacity ? oldCapacity * 2 : 256;
+	stringTable.slots = calloc(stringTable.capacity, sizeof(char*));
+	stringTable.hashes = malloc(stringTable.capacity * sizeof(uint32_t));
+	for (i=0; i<oldCapacity; i++){
+		if (oldSlots[i]){
+			size_t slot = oldHashes[i] & (stringTable.capacity - 1);
+			while (stringTable.slots[slot])
+				slot = (slot + 1) & (stringTable.capacity - 1);
+			stringTable.slots[slot] = oldSlots[i];
+			stringTable.hashes[slot] = oldHashes[i];
+		}
+	}
+	free(oldSlots);
+	free(oldHashes);
+}
+
+/*
+ * internLowercase()
+ * finds the interned copy of the lowercase version of a string, storing it first if it is a new name
+ *
+ * Params:
+ * 	string
+ * 	the characters of the name, not necessarily NUL terminated
+ *
+ * 	length
+ * 	number of characters of the name
+ *
+ * Return:
+ * 	pointer to the interned name, valid until releaseStringTable()
+ */
+char* internLowercase(const char* string, size_t length){
+	if ((stringTable.count + 1) * 4 > stringTable.capacity * 3)
+		growStringTable();
+	uint32_t hash = hashLowercase(string, length);
+	size_t slot = hash & (stringTable.capacity - 1);
+	while (stringTable.slots[slot]){
+		if (stringTable.hashes[slot] == hash && equalsLowercase(stringTable.slots[slot], string, length))
+			return stringTable.slots[slot];
+		slot = (slot + 1) & (stringTable.capacity - 1);
+	}
+	stringTable.slots[slot] = arenaCopyLowercase(string, length);
+	stringTable.hashes[slot] = hash;
+	stringTable.count++;
+	return stringTable.slots[slot];
+}
+
+/*
+ * releaseStringTable()
+ * frees every interned name and the hash set at once, and leaves the table empty
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void releaseStringTable(){
+	struct slab* cursor = stringTable.slabs;
+	struct slab* temp;
+	while (cursor){
+		temp = cursor;
+		cursor = cursor->next;
+		free(temp);
+	}
+	free(stringTable.slots);
+	free(stringTable.hashes);
+	memset(&stringTable, 0, sizeof(stringTable));
+}
@@ -3,67 +3,179 @@
 #include <ctype.h>
 #include <string.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <time.h>
+#include "warehouse.h"
 #define BOOLEAN char
 #define FALSE 0
 #define TRUE 1
 
 
+static int errorCount = 0;
+static int silenced = 0; // silenceOutput() calls not yet undone, while which errors are not counted
+
 /*
- * commandSplitter()
+ * printError()
+ * prints an error message to stdout through outputError(), prefixed by "ERROR: ", and counts it so a batch can stop at its first error
+ * errors printed while stdout is silenced are not seen, so they are not counted either
+ *
+ * Params
+ * 	format, ...
+ * 	as for printf()
+ *
+ * Return
+ * 	void
+ */
+void printError(const char* format, ...){
+	va_list arguments;
+	va_start(arguments, format);
+	if (!silenced)
+		errorCount++;
+	outputError(format, arguments);
+	va_end(arguments);
+}
+
+/*
+ * errorsPrinted()
+ * tells how many errors printError() has printed so far
+ *
+ * Params: void
+ *
+ * Return
+ * 	the number of errors
+ */
+int errorsPrinted(){
+	return errorCount;
+}
+
+/*
+ * splitCommand()
  * splits a command into its commponents, by whitespace, while keeping words within quotes (i.e. "hello there") as one argument
  *
  * Params
  * 	commandLine
- * 	pointer to a string. It's contents are changed and referenced by the return value, so it shouldn't be altered outside of this function for the return values's duration of use (done so each *output need not be free()'d)
- *	
+ * 	pointer to a string. It's contents are changed and referenced by output, so it shouldn't be altered outside of this function for output's duration of use
+ *
  *	maxArgs
  *	value to determine the maximum amount of args checked for and returned
  *
+ *	output
+ *	room for maxArgs+1 string pointers, filled with the arguments and NULLs after them
+ *
  * Return
- * 	Pointer to pointers of strings, up to maxArgs
+ * 	the number of arguments, 0 for a blank line, or -1 if a quote isn't closed
  */
-char** commandSplitter(char* commandLine, int maxArgs, BOOLEAN userInput){
-	while (isspace(*commandLine)) commandLine++;
-	if (*commandLine == '\0'){
-		return NULL;
-	}
-	char** output = malloc((maxArgs+1)*sizeof(char *));
+int splitCommand(char* commandLine, int maxArgs, char** output){
+	int index = 0;
 	int i;
 	for (i=0; i<(maxArgs+1); i++)
 		output[i] = NULL;
-	int index = 0;
-	output[index] = commandLine;
+	while (isspace(*commandLine)) commandLine++;
 	
-	while (*++commandLine != '\0'){
-		if (isspace(*commandLine)){
-			if (*commandLine == '\n'){
-				*commandLine = '\0';
-				return output;
-			}
-			*commandLine = '\0';
-			if (index >= maxArgs-1)
-				return output;
-			while (isspace(*++commandLine));
-			if (*commandLine == '\0')
-				return output;
-			if (*commandLine == '\"'){
-				output[++index] = ++commandLine;
-				while (*commandLine != '\"'){
-					if (*commandLine == '\0'){
-						free(output);
-						return NULL;
-					}
-					commandLine++;
-				}
-				*commandLine = '\0';
+	while (*commandLine != '\0' && index < maxArgs){
+		if (*commandLine == '\"' && index > 0){
+			output[index++] = ++commandLine;
+			while (*commandLine != '\"'){
+				if (*commandLine == '\0')
+					return -1;
 				commandLine++;
 			}
-			output[++index] = commandLine;
+			*commandLine++ = '\0';
+		}
+		else{
+			output[index++] = commandLine;
+			while (*commandLine != '\0' && !isspace(*commandLine))
+				commandLine++;
+			if (*commandLine != '\0')
+				*commandLine++ = '\0';
 		}
+		while (isspace(*commandLine)) commandLine++;
+	}
+	return index;
+}
+
+/*
+ * quotedArgument()
+ * tells whether an argument was within quotes, e.g. to take a quoted ">" as a name rather than a redirection
+ * an unquoted argument split by splitCommand() follows whitespace or the end of the previous argument, while a quoted one starts right
+ * after its opening quote; the arguments replayed from the journal follow their length and are all taken as quoted
+ *
+ * Params
+ * 	arg
+ * 	an argument other than the first (which is never quoted)
+ *
+ * Return
+ * 	TRUE if the argument was quoted
+ */
+BOOLEAN quotedArgument(char* arg){
+	return arg[-1] != '\0' && !isspace(arg[-1]);
+}
+
+/*
+ * commandSplitter()
+ * splitCommand() into a newly allocated vector
+ *
+ * Params
+ * 	commandLine, maxArgs
+ * 	as for splitCommand()
+ *
+ * Return
+ * 	Pointer to pointers of strings, up to maxArgs, to be free()'d (but not each *output); NULL for a blank or badly quoted line
+ */
+char** commandSplitter(char* commandLine, int maxArgs){
+	char** output = malloc((maxArgs+1)*sizeof(char *));
+	if (splitCommand(commandLine, maxArgs, output) <= 0){
+		free(output);
+		return NULL;
 	}
 	return output;
 }
 
+/*
+ * silenceOutput()
+ * sends stdout to /dev/null, e.g. while commands whose output was already shown are replayed, and stops printError() from counting
+ *
+ * Params:	void
+ *
+ * Return:
+ * 	descriptor of the real stdout, to be handed to restoreOutput()
+ */
+int silenceOutput(){
+	flushOutput();
+	fflush(stdout);
+	silenced++;
+	int saved = dup(STDOUT_FILENO);
+	int devNull = open("/dev/null", O_WRONLY);
+	if (devNull >= 0){
+		dup2(devNull, STDOUT_FILENO);
+		close(devNull);
+	}
+	return saved;
+}
+
+/*
+ * restoreOutput()
+ * undoes silenceOutput()
+ *
+ * Params:
+ * 	saved
+ * 	the descriptor returned by silenceOutput()
+ *
+ * Return:
+ * 	void
+ */
+void restoreOutput(int saved){
+	flushOutput();
+	fflush(stdout);
+	silenced--;
+	if (saved >= 0){
+		dup2(saved, STDOUT_FILENO);
+		close(saved);
+	}
+}
+
 /*
  * executeCommand()
  * must be defined separately for each program
@@ -93,7 +205,8 @@ BOOLEAN executeCommand(char** arguments);
 /*
  * shell_loop()
  * runs the loop of the main program to ask for input from the user and execute accordingly
- * ends when executeCommand returns false
+ * ends when executeCommand returns false, or at the end of the input
+ * the line buffer and the argument vector are reused by every command, and the journal is synced before waiting for the next one
  *
  * Params
  * 	maxArgs
@@ -104,21 +217,94 @@ BOOLEAN executeCommand(char** arguments);
  */
 void shell_loop(int maxArgs){
 	char* commandLine = NULL;
-	char** args;
+	char** args = malloc((maxArgs+1)*sizeof(char *));
 	size_t bufsize = 0;
 	BOOLEAN notExit = TRUE;
 	
 	while(notExit){
-		printf("> ");
-		getline(&commandLine, &bufsize, stdin);
-		args = commandSplitter(commandLine, maxArgs, TRUE);
-		if (args){
+		outputString("> ");
+		flushOutput();
+		syncJournal();
+		if (getline(&commandLine, &bufsize, stdin) < 0)
+			break;
+		if (splitCommand(commandLine, maxArgs, args) > 0)
 			notExit = executeCommand(args);
-			free(args);
+		else
+			printError("not a valid command, type \"help\" for a list of commands.\n");
+	}
+	free(commandLine);
+	free(args);
+}
+
+/*
+ * runBatch()
+ * executes a whole script of commands without prompts, reading it in one go and splitting its lines in place
+ * blank lines and lines starting with '#' are skipped; the time taken is reported to stderr at the end
+ *
+ * Params
+ * 	script
+ * 	the opened script (or stdin)
+ *
+ * 	maxArgs
+ * 	as for shell_loop()
+ *
+ * 	stopOnError
+ * 	TRUE to stop at the first command that prints an error
+ *
+ * Return
+ * 	TRUE if the script ran to its end (or to an exit command), FALSE if it stopped at an error
+ */
+BOOLEAN runBatch(FILE* script, int maxArgs, BOOLEAN stopOnError){
+	size_t length = 0;
+	size_t capacity = 64 * 1024;
+	size_t bytes;
+	char* contents = malloc(capacity + 1);
+	while ((bytes = fread(contents + length, 1, capacity - length, script))){
+		length += bytes;
+		if (length == capacity){
+			capacity *= 2;
+			contents = realloc(contents, capacity + 1);
 		}
+	}
+	contents[length] = '\0';
+
+	char** args = malloc((maxArgs+1)*sizeof(char *));
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	int errorsBefore = errorCount;
+	int commands = 0;
+	int lineNumber = 0;
+	BOOLEAN completed = TRUE;
+	char* line = contents;
+	while (line < contents + length){
+		char* lineEnd = strchr(line, '\n');
+		if (lineEnd)
+			*lineEnd = '\0';
 		else
-			printf("ERROR: not a valid command, type \"help\" for a list of commands.\n");
-		free(commandLine);
-		commandLine = NULL;
+			lineEnd = contents + length;
+		lineNumber++;
+		int errors = errorCount;
+		int count = splitCommand(line, maxArgs, args);
+		line = lineEnd + 1;
+		if (!count || **args == '#')
+			continue;
+		commands++;
+		if (count < 0)
+			printError("not a valid command, type \"help\" for a list of commands.\n");
+		else if (!executeCommand(args))
+			break;
+		if (stopOnError && errorCount != errors){
+			flushOutput();
+			fprintf(stderr, "batch stopped at line %d\n", lineNumber);
+			completed = FALSE;
+			break;
+		}
 	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	flushOutput();
+	fprintf(stderr, "batch: %d commands, %d errors, %f seconds\n", commands, errorCount - errorsBefore,
+		(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+	free(args);
+	free(contents);
+	return completed;
 }
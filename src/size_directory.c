@@ -0,0 +1,466 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * size_directory
+ * Array of every member of the segregated list, sorted by class size so a class can be found by binary search
+ * has_free holds one bit per entry of classes, set while that class has at least one unoccupied warehouse,
+ * so the search for a class with room skips full classes a word (64 classes) at a time
+ * Members of the segregated list are never removed, so the directory only grows
+ */
+struct size_directory {
+	struct warehouse_sf_list** classes;
+	uint64_t* has_free;
+	size_t count;
+	size_t capacity;
+};
+
+static struct size_directory sizeDirectory = { NULL, NULL, 0, 0 };
+
+/*
+ * lowerBound()
+ * binary search for the first class of the directory whose size is at least the specified size
+ *
+ * Params:
+ * 	size
+ * 	the size searched for
+ *
+ * Return:
+ * 	index of that class, sizeDirectory.count if every class is smaller
+ */
+static size_t lowerBound(int size){
+	size_t low = 0;
+	size_t high = sizeDirectory.count;
+	while (low < high){
+		size_t mid = low + (high - low) / 2;
+		if (sizeDirectory.classes[mid]->class_size < size)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/*
+ * setHasFree()
+ * updates the bit of the has_free bitmap for the class at the specified index of the directory
+ *
+ * Params:
+ * 	index
+ * 	position of the class in the directory
+ *
+ * Return:
+ * 	void
+ */
+static void setHasFree(size_t index){
+	uint64_t mask = (uint64_t)1 << (index & 63);
+	if (sizeDirectory.classes[index]->free_count)
+		sizeDirectory.has_free[index >> 6] |= mask;
+	else
+		sizeDirectory.has_free[index >> 6] &= ~mask;
+}
+
+/*
+ * findSFList()
+ * finds the member of the segregated list for a class size
+ *
+ * Params:
+ * 	class_size
+ * 	size of the class looked for
+ *
+ * Return:
+ * 	pointer to the member of that class size, NULL if there is none yet
+ */
+struct warehouse_sf_list* findSFList(int class_size){
+	size_t index = lowerBound(class_size);
+	if (index < sizeDirectory.count && sizeDirectory.classes[index]->class_size == class_size)
+		return sizeDirectory.classes[index];
+	return NULL;
+}
+
+/*
+ * addSFList()
+ * adds a new member of the segregated list to the directory, keeping it sorted by class size
+ *
+ * Params:
+ * 	sf
+ * 	the new member, whose class size must not be in the directory yet
+ *
+ * Return:
+ * 	the member of the next smaller class size (so the caller can link sf after it), NULL if sf is the smallest
+ */
+struct warehouse_sf_list* addSFList(struct warehouse_sf_list* sf){
+	if (sizeDirectory.count == sizeDirectory.capacity){
+		size_t oldWords = sizeDirectory.capacity / 64;
+		sizeDirectory.capacity = sizeDirectory.capacity ? sizeDirectory.capacity * 2 : 64;
+		sizeDirectory.classes = realloc(sizeDirectory.classes, sizeDirectory.capacity * sizeof(struct warehouse_sf_list*));
+		sizeDirectory.has_free = realloc(sizeDirectory.has_free, (sizeDirectory.capacity / 64) * sizeof(uint64_t));
+		memset(sizeDirectory.has_free + oldWords, 0, (sizeDirectory.capacity / 64 - oldWords) * sizeof(uint64_t));
+	}
+	size_t index = lowerBound(sf->class_size);
+	memmove(sizeDirectory.classes + index + 1, sizeDirectory.classes + index, (sizeDirectory.count - index) * sizeof(struct warehouse_sf_list*));
+	sizeDirectory.classes[index] = sf;
+	sizeDirectory.count++;
+	// every class from index on moved one slot up, so their positions and bits are rewritten
+	size_t i;
+	for (i=index; i<sizeDirectory.count; i++){
+		sizeDirectory.classes[i]->directory_index = i;
+		setHasFree(i);
+	}
+	return index ? sizeDirectory.classes[index - 1] : NULL;
+}
+
+/*
+ * slots
+ * Every class keeps its members in slots, in order: an appended member takes the next slot, an unlinked one leaves a hole
+ * What scans of the database read of a member is kept in arrays indexed by slot (its ID and art collection), next to three bitmaps
+ * of a bit per slot (live, free and private), so a scan reads a class sequentially rather than following pointers from member to member
+ * The first unoccupied warehouse of a class is found a word (64 slots) at a time by ctz, and the members of a class are counted by popcount
+ * Members are linked by their 32 bit slots: the previous or next member of a class is the closest live slot before or after it
+ * Once holes make up most of the slots, the members are moved down over them, keeping their order
+ */
+#define SLOT_WORD(slot) ((slot) >> 6)
+#define SLOT_BIT(slot) ((uint64_t)1 << ((slot) & 63))
+
+/*
+ * growSlots()
+ * doubles the slots of a class, its arrays and its bitmaps
+ *
+ * Params:
+ * 	sf
+ * 	the class, whose slots are all used
+ *
+ * Return:
+ * 	void
+ */
+static void growSlots(struct warehouse_sf_list* sf){
+	uint32_t oldWords = sf->slot_capacity / 64;
+	sf->slot_capacity = sf->slot_capacity ? sf->slot_capacity * 2 : 64;
+	uint32_t words = sf->slot_capacity / 64;
+	sf->slots = realloc(sf->slots, sf->slot_capacity * sizeof(struct warehouse_list*));
+	sf->ids = realloc(sf->ids, sf->slot_capacity * sizeof(int32_t));
+	sf->arts = realloc(sf->arts, sf->slot_capacity * sizeof(struct art_collection*));
+	sf->live_bits = realloc(sf->live_bits, words * sizeof(uint64_t));
+	sf->free_bits = realloc(sf->free_bits, words * sizeof(uint64_t));
+	sf->private_bits = realloc(sf->private_bits, words * sizeof(uint64_t));
+	memset(sf->live_bits + oldWords, 0, (words - oldWords) * sizeof(uint64_t));
+	memset(sf->free_bits + oldWords, 0, (words - oldWords) * sizeof(uint64_t));
+	memset(sf->private_bits + oldWords, 0, (words - oldWords) * sizeof(uint64_t));
+}
+
+/*
+ * compactSlots()
+ * moves the members of a class down over the holes, in order, along with their IDs, art collections and bits
+ *
+ * Params:
+ * 	sf
+ * 	the class
+ *
+ * Return:
+ * 	void
+ */
+static void compactSlots(struct warehouse_sf_list* sf){
+	uint32_t used = 0;
+	uint32_t slot;
+	for (slot = 0; slot < sf->slot_count; slot++){
+		struct warehouse_list* wl = sf->slots[slot];
+		if (!wl)
+			continue;
+		uint64_t bit = SLOT_BIT(slot);
+		BOOLEAN isFree = (sf->free_bits[SLOT_WORD(slot)] & bit) != 0;
+		BOOLEAN isPrivate = (sf->private_bits[SLOT_WORD(slot)] & bit) != 0;
+		sf->live_bits[SLOT_WORD(slot)] &= ~bit;
+		sf->free_bits[SLOT_WORD(slot)] &= ~bit;
+		sf->private_bits[SLOT_WORD(slot)] &= ~bit;
+		bit = SLOT_BIT(used);
+		sf->live_bits[SLOT_WORD(used)] |= bit;
+		if (isFree)
+			sf->free_bits[SLOT_WORD(used)] |= bit;
+		if (isPrivate)
+			sf->private_bits[SLOT_WORD(used)] |= bit;
+		sf->slots[used] = wl;
+		sf->ids[used] = sf->ids[slot];
+		sf->arts[used] = sf->arts[slot];
+		wl->slot = used++;
+	}
+	sf->slot_count = used;
+	sf->holes = 0;
+	sf->first_free_word = 0;
+}
+
+/*
+ * addClassMember()
+ * gives a new, unoccupied member of a class the next slot, which isn't marked free until pushFreeWarehouse()
+ *
+ * Params:
+ * 	sf
+ * 	the class of the warehouse
+ *
+ * 	wl
+ * 	the new member
+ *
+ * Return:
+ * 	void
+ */
+void addClassMember(struct warehouse_sf_list* sf, struct warehouse_list* wl){
+	if (sf->slot_count == sf->slot_capacity)
+		growSlots(sf);
+	wl->slot = sf->slot_count++;
+	sf->slots[wl->slot] = wl;
+	sf->ids[wl->slot] = wl->warehouse->id;
+	sf->arts[wl->slot] = NULL;
+	sf->live_bits[SLOT_WORD(wl->slot)] |= SLOT_BIT(wl->slot);
+	if (wl->meta_info & 1)
+		sf->private_bits[SLOT_WORD(wl->slot)] |= SLOT_BIT(wl->slot);
+}
+
+/*
+ * removeClassMember()
+ * empties the slot of a member unlinked from its class (already off the free bitmap), compacting the slots if most are holes
+ *
+ * Params:
+ * 	sf
+ * 	the class of the warehouse
+ *
+ * 	wl
+ * 	the unlinked member
+ *
+ * Return:
+ * 	void
+ */
+void removeClassMember(struct warehouse_sf_list* sf, struct warehouse_list* wl){
+	sf->slots[wl->slot] = NULL;
+	sf->live_bits[SLOT_WORD(wl->slot)] &= ~SLOT_BIT(wl->slot);
+	sf->private_bits[SLOT_WORD(wl->slot)] &= ~SLOT_BIT(wl->slot);
+	if (wl->slot + 1 == sf->slot_count)
+		sf->slot_count--;
+	else
+		sf->holes++;
+	if (sf->holes > 64 && sf->holes * 2 > sf->slot_count)
+		compactSlots(sf);
+}
+
+/*
+ * previousClassMember()
+ * finds the member of the closest live slot before a member of a class, through the live bitmap
+ *
+ * Params:
+ * 	sf
+ * 	the class
+ *
+ * 	wl
+ * 	a member of the class
+ *
+ * Return:
+ * 	the previous member, NULL if wl is the first
+ */
+struct warehouse_list* previousClassMember(struct warehouse_sf_list* sf, struct warehouse_list* wl){
+	uint32_t word = SLOT_WORD(wl->slot);
+	uint64_t bits = sf->live_bits[word] & (SLOT_BIT(wl->slot) - 1);
+	while (!bits){
+		if (!word)
+			return NULL;
+		bits = sf->live_bits[--word];
+	}
+	return sf->slots[(word << 6) + 63 - __builtin_clzll(bits)];
+}
+
+/*
+ * nextClassMember()
+ * finds the member of the closest live slot after a member of a class, through the live bitmap
+ *
+ * Params:
+ * 	sf
+ * 	the class
+ *
+ * 	wl
+ * 	a member of the class
+ *
+ * Return:
+ * 	the next member, NULL if wl is the last
+ */
+struct warehouse_list* nextClassMember(struct warehouse_sf_list* sf, struct warehouse_list* wl){
+	uint32_t words = (sf->slot_count + 63) / 64;
+	uint32_t word = SLOT_WORD(wl->slot);
+	uint64_t bits = sf->live_bits[word] & ~(SLOT_BIT(wl->slot) * 2 - 1);
+	while (!bits){
+		if (++word >= words)
+			return NULL;
+		bits = sf->live_bits[word];
+	}
+	return sf->slots[(word << 6) + __builtin_ctzll(bits)];
+}
+
+/*
+ * pushFreeWarehouse()
+ * marks an unoccupied warehouse free in the bitmap of its class
+ * the first free warehouse is then the one a walk of the warehouse list would find first, as its slot is the lowest
+ * a root warehouse (one no split made) also goes on the free root heap of defrag.c
+ *
+ * Params:
+ * 	sf
+ * 	the class of the warehouse
+ *
+ * 	wl
+ * 	the unoccupied warehouse list member, which has a slot
+ *
+ * Return:
+ * 	void
+ */
+void pushFreeWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl){
+	sf->free_bits[SLOT_WORD(wl->slot)] |= SLOT_BIT(wl->slot);
+	if (SLOT_WORD(wl->slot) < sf->first_free_word)
+		sf->first_free_word = SLOT_WORD(wl->slot);
+	if (!sf->free_count++)
+		setHasFree(sf->directory_index);
+	if (!wl->split)
+		addFreeRoot(wl);
+}
+
+/*
+ * removeFreeWarehouse()
+ * clears the free bit of a warehouse, either because it was filled or because it is being freed
+ *
+ * Params:
+ * 	sf
+ * 	the class of the warehouse
+ *
+ * 	wl
+ * 	the unoccupied warehouse list member
+ *
+ * Return:
+ * 	void
+ */
+void removeFreeWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl){
+	sf->free_bits[SLOT_WORD(wl->slot)] &= ~SLOT_BIT(wl->slot);
+	if (!--sf->free_count)
+		setHasFree(sf->directory_index);
+	if (!wl->split)
+		removeFreeRoot(wl);
+}
+
+/*
+ * findFreeWarehouse()
+ * finds the first unoccupied warehouse of the smallest class that is large enough and has one
+ * the class comes from the has_free bitmap of the directory and the warehouse from the free bitmap of the class
+ *
+ * Params:
+ * 	size
+ * 	the size the warehouse must at least have
+ *
+ * 	sf
+ * 	set to the class of the warehouse found
+ * 	if none is found, set to the smallest class that is large enough, or NULL if there is no such class
+ *
+ * Return:
+ * 	pointer to the unoccupied warehouse list member, NULL if none is large enough
+ */
+struct warehouse_list* findFreeWarehouse(int size, struct warehouse_sf_list** sf){
+	size_t index = lowerBound(size);
+	if (index >= sizeDirectory.count){
+		*sf = NULL;
+		return NULL;
+	}
+	*sf = sizeDirectory.classes[index];
+	size_t words = (sizeDirectory.count + 63) >> 6;
+	size_t word = index >> 6;
+	uint64_t bits = sizeDirectory.has_free[word] & (~(uint64_t)0 << (index & 63));
+	while (!bits){
+		if (++word >= words)
+			return NULL;
+		bits = sizeDirectory.has_free[word];
+	}
+	struct warehouse_sf_list* found = sizeDirectory.classes[(word << 6) + __builtin_ctzll(bits)];
+	*sf = found;
+	// the class has a free member, so the scan ends at its word, which is remembered for the next search
+	while (!found->free_bits[found->first_free_word])
+		found->first_free_word++;
+	return found->slots[(found->first_free_word << 6) + __builtin_ctzll(found->free_bits[found->first_free_word])];
+}
+
+/*
+ * occupiedSlots()
+ * gives the bits of one word of the slots of a class that hold occupied members of the visibility asked for
+ *
+ * Params:
+ * 	sf
+ * 	the class
+ *
+ * 	word
+ * 	index of the word (slots 64 * word to 64 * word + 63)
+ *
+ * 	all
+ * 	TRUE for members of both visibilities
+ *
+ * 	private
+ * 	TRUE for private members, FALSE for public ones, overridden by all
+ *
+ * Return:
+ * 	the bits of those slots
+ */
+uint64_t occupiedSlots(struct warehouse_sf_list* sf, uint32_t word, BOOLEAN all, BOOLEAN private){
+	uint64_t bits = sf->live_bits[word] & ~sf->free_bits[word];
+	if (!all)
+		bits &= private ? sf->private_bits[word] : ~sf->private_bits[word];
+	return bits;
+}
+
+/*
+ * countClassMembers()
+ * counts the members of a class of one visibility, by popcount of its bitmaps
+ *
+ * Params:
+ * 	sf
+ * 	the class
+ *
+ * 	private
+ * 	TRUE to count private members, FALSE for public ones
+ *
+ * 	occupied
+ * 	TRUE to count occupied members, FALSE for unoccupied ones
+ *
+ * Return:
+ * 	the number of members
+ */
+long countClassMembers(struct warehouse_sf_list* sf, BOOLEAN private, BOOLEAN occupied){
+	long count = 0;
+	uint32_t word;
+	for (word = 0; word < (sf->slot_count + 63) / 64; word++){
+		uint64_t bits = occupied ? occupiedSlots(sf, word, FALSE, private)
+			: sf->free_bits[word] & (private ? sf->private_bits[word] : ~sf->private_bits[word]);
+		count += __builtin_popcountll(bits);
+	}
+	return count;
+}
+
+/*
+ * freeSizeDirectory()
+ * frees the directory and the slots of every class (not the members of the segregated list themselves) and leaves it empty
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void freeSizeDirectory(){
+	size_t i;
+	for (i=0; i<sizeDirectory.count; i++){
+		free(sizeDirectory.classes[i]->slots);
+		free(sizeDirectory.classes[i]->ids);
+		free(sizeDirectory.classes[i]->arts);
+		free(sizeDirectory.classes[i]->live_bits);
+		free(sizeDirectory.classes[i]->free_bits);
+		free(sizeDirectory.classes[i]->private_bits);
+	}
+	free(sizeDirectory.classes);
+	free(sizeDirectory.has_free);
+	sizeDirectory.classes = NULL;
+	sizeDirectory.has_free = NULL;
+	sizeDirectory.count = 0;
+	sizeDirectory.capacity = 0;
+}
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * Layout of a snapshot file (native byte order, every section starts 8 byte aligned)
+ *
+ * 	snapshot_header
+ * 	snapshot_class[class_count]		the classes of the sf list, smallest first
+ * 	snapshot_warehouse[warehouse_count]	the members of every class, class after class and in slot order
+ * 	snapshot_split[split_count]		the split records of the warehouses, every record after its parent
+ * 	int32_t[recycled_count]			the recycled stack of the ID allocator, bottom first (padded to 8 bytes)
+ * 	char[name_bytes]			the NUL terminated names of the art collections, referred to by offset
+ *
+ * Every section has a fixed size known from the header, so the whole image is checked before the database is touched
+ * and is then rebuilt with a single pass over a mapping of the file
+ *
+ * A warehouse or split record refers to the split record it is a half of as (index + 1) << 1 | the half it is, 0 meaning none
+ */
+#define SNAPSHOT_MAGIC "ARTDBSNP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_NO_ART UINT32_MAX
+
+struct snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t class_count;
+	uint64_t warehouse_count;
+	uint64_t name_bytes;
+	uint32_t recycled_count;
+	int32_t next_fresh_id;
+	uint32_t split_count;
+	uint32_t reserved;
+};
+
+struct snapshot_class {
+	int32_t class_size;
+	uint32_t member_count;
+};
+
+struct snapshot_warehouse {
+	uint64_t meta_info; // only the occupied and private bits are used, the size is in size
+	int32_t id;
+	int32_t size;
+	int32_t art_size;
+	int32_t art_price;
+	uint32_t art_name; // offset into the names, or SNAPSHOT_NO_ART if the warehouse is unoccupied
+	uint32_t split; // reference to the split record it is a half of
+};
+
+struct snapshot_split {
+	uint32_t parent; // reference to the split record the split warehouse was a half of
+	uint32_t reserved;
+};
+
+/*
+ * name_offsets
+ * Open addressing table from an interned name to its offset in the names being written
+ * Interned names are unique, so the pointer itself is the key
+ */
+struct name_offsets {
+	const char** keys;
+	uint32_t* offsets;
+	size_t capacity;
+	size_t count;
+	char* names;
+	size_t names_length;
+	size_t names_capacity;
+};
+
+/*
+ * nameOffset()
+ * finds the offset of an interned name in the names being written, appending it the first time it is seen
+ *
+ * Params:
+ * 	table
+ * 	the names being written
+ *
+ * 	name
+ * 	an interned name
+ *
+ * Return:
+ * 	offset of the name
+ */
+static uint32_t nameOffset(struct name_offsets* table, const char* name){
+	if ((table->count + 1) * 4 > table->capacity * 3){
+		size_t oldCapacity = table->capacity;
+		const char** oldKeys = table->keys;
+		uint32_t* oldOffsets = table->offsets;
+		table->capacity = oldCapacity ? oldCapacity * 2 : 1024;
+		table->keys = calloc(table->capacity, sizeof(char*));
+		table->offsets = malloc(table->capacity * sizeof(uint32_t));
+		for (size_t i = 0; i < oldCapacity; i++){
+			if (!oldKeys[i])
+				continue;
+			size_t slot = ((uintptr_t)oldKeys[i] >> 3) * 0x9E3779B97F4A7C15ull >> 32 & (table->capacity - 1);
+			while (table->keys[slot])
+				slot = (slot + 1) & (table->capacity - 1);
+			table->keys[slot] = oldKeys[i];
+			table->offsets[slot] = oldOffsets[i];
+		}
+		free(oldKeys);
+		free(oldOffsets);
+	}
+	size_t slot = ((uintptr_t)name >> 3) * 0x9E3779B97F4A7C15ull >> 32 & (table->capacity - 1);
+	while (table->keys[slot]){
+		if (table->keys[slot] == name)
+			return table->offsets[slot];
+		slot = (slot + 1) & (table->capacity - 1);
+	}
+	size_t length = strlen(name) + 1;
+	while (table->names_length + length > table->names_capacity){
+		table->names_capacity = table->names_capacity ? table->names_capacity * 2 : 64 * 1024;
+		table->names = realloc(table->names, table->names_capacity);
+	}
+	memcpy(table->names + table->names_length, name, length);
+	table->keys[slot] = name;
+	table->offsets[slot] = table->names_length;
+	table->count++;
+	table->names_length += length;
+	return table->offsets[slot];
+}
+
+/*
+ * split_numbers
+ * The split records being written, in order, each numbered (index + 1) in its index field until the snapshot is written
+ */
+struct split_numbers {
+	struct warehouse_split** records;
+	size_t count;
+	size_t capacity;
+};
+
+/*
+ * splitReference()
+ * gives the reference to a half of a split record, numbering the record (and its unnumbered ancestors before it) the first time it is seen
+ *
+ * Params:
+ * 	table
+ * 	the split records being written
+ *
+ * 	split
+ * 	the split record referred to, or NULL
+ *
+ * 	side
+ * 	which half of it is referred to
+ *
+ * Return:
+ * 	the reference, 0 if split is NULL
+ */
+static uint32_t splitReference(struct split_numbers* table, struct warehouse_split* split, int side){
+	if (!split)
+		return 0;
+	if (!split->index){
+		// walked up iteratively, since a warehouse split again and again makes a chain as long as the number of splits
+		size_t unnumbered = 0;
+		struct warehouse_split* cursor;
+		for (cursor = split; cursor && !cursor->index; cursor = cursor->parent)
+			unnumbered++;
+		while (table->count + unnumbered > table->capacity){
+			table->capacity = table->capacity ? table->capacity * 2 : 1024;
+			table->records = realloc(table->records, table->capacity * sizeof(struct warehouse_split*));
+		}
+		table->count += unnumbered;
+		size_t position = table->count;
+		for (cursor = split; cursor && !cursor->index; cursor = cursor->parent){
+			table->records[--position] = cursor;
+			cursor->index = position + 1;
+		}
+	}
+	return split->index << 1 | side;
+}
+
+/*
+ * saveSnapshot()
+ * writes the whole database to a snapshot file, through a temporary file so an existing snapshot is only replaced by a complete one
+ *
+ * Params:
+ * 	fileName
+ * 	path of the snapshot to be written
+ *
+ * Return:
+ * 	TRUE if the snapshot was written
+ */
+BOOLEAN saveSnapshot(char* fileName){
+	struct snapshot_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	for (struct warehouse_sf_list* sf = sf_head; sf; sf = sf->sf_next_warehouse){
+		header.class_count++;
+		for (uint32_t word = 0; word < (sf->slot_count + 63) / 64; word++)
+			header.warehouse_count += __builtin_popcountll(sf->live_bits[word]);
+	}
+
+	struct snapshot_class* classes = malloc((header.class_count + 1) * sizeof(struct snapshot_class));
+	struct snapshot_warehouse* warehouses = malloc((header.warehouse_count + 1) * sizeof(struct snapshot_warehouse));
+	struct name_offsets names;
+	memset(&names, 0, sizeof(names));
+	struct split_numbers splits;
+	memset(&splits, 0, sizeof(splits));
+	size_t c = 0, w = 0;
+	for (struct warehouse_sf_list* sf = sf_head; sf; sf = sf->sf_next_warehouse, c++){
+		classes[c].class_size = sf->class_size;
+		classes[c].member_count = 0;
+		for (uint32_t slot = 0; slot < sf->slot_count; slot++){
+			if (!(sf->live_bits[slot >> 6] & (uint64_t)1 << (slot & 63)))
+				continue;
+			struct warehouse_list* wl = sf->slots[slot];
+			struct snapshot_warehouse* record = warehouses + w++;
+			struct art_collection* art = sf->arts[slot];
+			record->meta_info = wl->meta_info & 3;
+			record->id = sf->ids[slot];
+			record->size = sf->class_size;
+			record->art_size = art ? art->size : 0;
+			record->art_price = art ? art->price : 0;
+			record->art_name = art ? nameOffset(&names, art->name) : SNAPSHOT_NO_ART;
+			record->split = wl->split ? splitReference(&splits, wl->split, wl->split->halves[1] == wl) : 0;
+			classes[c].member_count++;
+		}
+	}
+	header.split_count = splits.count;
+	struct snapshot_split* splitRecords = malloc((splits.count + 1) * sizeof(struct snapshot_split));
+	for (size_t i = 0; i < splits.count; i++){
+		struct warehouse_split* split = splits.records[i];
+		splitRecords[i].parent = splitReference(&splits, split->parent, split->side);
+		splitRecords[i].reserved = 0;
+	}
+	for (size_t i = 0; i < splits.count; i++)
+		splits.records[i]->index = 0;
+	const int* recycled;
+	size_t recycledCount;
+	header.next_fresh_id = getIDAllocator(&recycled, &recycledCount);
+	header.recycled_count = recycledCount;
+	header.name_bytes = names.names_length;
+	int32_t padding = 0;
+
+	size_t length = strlen(fileName);
+	char* tempName = malloc(length + 5);
+	memcpy(tempName, fileName, length);
+	memcpy(tempName + length, ".tmp", 5);
+	BOOLEAN written = FALSE;
+	FILE* file = fopen(tempName, "wb");
+	if (!file){
+		printError("failed to open %s\n", tempName);
+	}
+	else{
+		written = fwrite(&header, sizeof(header), 1, file) == 1
+			&& fwrite(classes, sizeof(struct snapshot_class), header.class_count, file) == header.class_count
+			&& fwrite(warehouses, sizeof(struct snapshot_warehouse), header.warehouse_count, file) == header.warehouse_count
+			&& (!splits.count || fwrite(splitRecords, sizeof(struct snapshot_split), splits.count, file) == splits.count)
+			&& (!recycledCount || fwrite(recycled, sizeof(int32_t), recycledCount, file) == recycledCount)
+			&& fwrite(&padding, sizeof(int32_t), recycledCount & 1, file) == (recycledCount & 1)
+			&& (!names.names_length || fwrite(names.names, 1, names.names_length, file) == names.names_length)
+			&& !fflush(file) && !fsync(fileno(file));
+		if (fclose(file) || !written){
+			written = FALSE;
+			printError("failed to write the snapshot %s\n", fileName);
+			remove(tempName);
+		}
+		else if (rename(tempName, fileName)){
+			written = FALSE;
+			printError("failed to replace %s\n", fileName);
+			remove(tempName);
+		}
+	}
+	free(tempName);
+	free(classes);
+	free(warehouses);
+	free(splitRecords);
+	free(splits.records);
+	free(names.keys);
+	free(names.offsets);
+	free(names.names);
+	return written;
+}
+
+/*
+ * claimHalf()
+ * marks the half of a split record a reference points to as referred to
+ *
+ * Params:
+ * 	halves
+ * 	two flags per split record, set for the halves already referred to
+ *
+ * 	reference
+ * 	the reference, not 0
+ *
+ * 	limit
+ * 	number of split records it may point into (those before a split record, or all of them)
+ *
+ * Return:
+ * 	TRUE if the reference points into the limit at a half that wasn't referred to yet
+ */
+static BOOLEAN claimHalf(char* halves, uint32_t reference, uint32_t limit){
+	if (reference < 2 || (reference >> 1) > limit || halves[reference - 2])
+		return FALSE;
+	halves[reference - 2] = TRUE;
+	return TRUE;
+}
+
+/*
+ * claimID()
+ * adds a warehouse ID to the open addressing set of the IDs seen so far in a snapshot
+ *
+ * Params:
+ * 	ids
+ * 	the set, 0 marking an empty slot
+ *
+ * 	capacity
+ * 	its number of slots, a power of 2 larger than the number of IDs
+ *
+ * 	id
+ * 	the ID, positive
+ *
+ * Return:
+ * 	TRUE if the ID wasn't in the set yet
+ */
+static BOOLEAN claimID(int32_t* ids, size_t capacity, int32_t id){
+	size_t slot = (size_t)(((uint32_t)id * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+	while (ids[slot]){
+		if (ids[slot] == id)
+			return FALSE;
+		slot = (slot + 1) & (capacity - 1);
+	}
+	ids[slot] = id;
+	return TRUE;
+}
+
+/*
+ * checkSnapshot()
+ * makes sure a mapped snapshot is complete and consistent, so restoring it can't read past its end or fail halfway
+ * every ID must be positive and unique, every class size even and at least 4, and the ID allocator in the generated ID space
+ *
+ * Params:
+ * 	data, length
+ * 	contents of the snapshot file
+ *
+ * Return:
+ * 	TRUE if the snapshot can be restored
+ */
+static BOOLEAN checkSnapshot(const char* data, size_t length){
+	const struct snapshot_header* header = (const void*)data;
+	if (length < sizeof(*header) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic))){
+		printError("not a snapshot file.\n");
+		return FALSE;
+	}
+	if (header->version != SNAPSHOT_VERSION){
+		printError("snapshot version %u is not supported, expected %d.\n", header->version, SNAPSHOT_VERSION);
+		return FALSE;
+	}
+	uint64_t expected = sizeof(*header)
+		+ (uint64_t)header->class_count * sizeof(struct snapshot_class)
+		+ header->warehouse_count * sizeof(struct snapshot_warehouse)
+		+ (uint64_t)header->split_count * sizeof(struct snapshot_split)
+		+ ((uint64_t)header->recycled_count + (header->recycled_count & 1)) * sizeof(int32_t)
+		+ header->name_bytes;
+	if (header->warehouse_count > length || header->name_bytes > length || expected != length){
+		printError("snapshot file is truncated or corrupted.\n");
+		return FALSE;
+	}
+	const struct snapshot_class* classes = (const void*)(header + 1);
+	const struct snapshot_warehouse* warehouses = (const void*)(classes + header->class_count);
+	const struct snapshot_split* splits = (const void*)(warehouses + header->warehouse_count);
+	const int32_t* recycled = (const void*)(splits + header->split_count);
+	const char* names = data + length - header->name_bytes;
+	if ((header->name_bytes && names[header->name_bytes - 1])
+			|| !validIDAllocator(header->next_fresh_id, recycled, header->recycled_count)){
+		printError("snapshot file is truncated or corrupted.\n");
+		return FALSE;
+	}
+
+	// every half of every split record must be referred to exactly once, by a warehouse or by a later split record
+	char* halves = calloc(2 * (size_t)header->split_count + 1, 1);
+	size_t idCapacity = 64;
+	while (idCapacity < 2 * header->warehouse_count)
+		idCapacity *= 2;
+	int32_t* ids = calloc(idCapacity, sizeof(int32_t));
+	BOOLEAN valid = TRUE;
+	for (uint32_t i = 0; i < header->split_count && valid; i++)
+		valid = !splits[i].parent || claimHalf(halves, splits[i].parent, i);
+	uint64_t w = 0;
+	for (uint32_t c = 0; c < header->class_count; c++){
+		if (classes[c].member_count > header->warehouse_count - w
+				|| (classes[c].class_size & 1) || classes[c].class_size < 4
+				|| (c && classes[c].class_size <= classes[c - 1].class_size)){
+			printError("snapshot file is truncated or corrupted.\n");
+			free(halves);
+			free(ids);
+			return FALSE;
+		}
+		for (uint32_t i = 0; i < classes[c].member_count; i++, w++){
+			const struct snapshot_warehouse* record = warehouses + w;
+			if (record->size != classes[c].class_size || record->id <= 0 || !claimID(ids, idCapacity, record->id)
+					|| (record->meta_info & 2 ? record->art_name >= header->name_bytes : record->art_name != SNAPSHOT_NO_ART)
+					|| (record->split && !claimHalf(halves, record->split, header->split_count))){
+				printError("snapshot file is truncated or corrupted.\n");
+				free(halves);
+				free(ids);
+				return FALSE;
+			}
+		}
+	}
+	for (size_t i = 0; i < 2 * (size_t)header->split_count && valid; i++)
+		valid = halves[i];
+	free(halves);
+	free(ids);
+	if (w != header->warehouse_count || !valid){
+		printError("snapshot file is truncated or corrupted.\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * loadSnapshot()
+ * replaces the whole database by the one saved in a snapshot file
+ * the classes and their members are rebuilt in the saved order, so the database behaves exactly as it did when it was saved
+ * a snapshot that fails its checks leaves the database untouched; one that still can't be rebuilt leaves it empty
+ *
+ * Params:
+ * 	fileName
+ * 	path of the snapshot to be restored
+ *
+ * Return:
+ * 	TRUE if the snapshot was restored
+ */
+BOOLEAN loadSnapshot(char* fileName){
+	FILE* file = fopen(fileName, "rb");
+	if (!file){
+		printError("failed to open %s\n", fileName);
+		return FALSE;
+	}
+	struct stat info;
+	const char* data = MAP_FAILED;
+	if (!fstat(fileno(file), &info) && info.st_size > 0)
+		data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	fclose(file);
+	if (data == MAP_FAILED){
+		printError("not a snapshot file.\n");
+		return FALSE;
+	}
+	madvise((void*)data, info.st_size, MADV_SEQUENTIAL);
+	if (!checkSnapshot(data, info.st_size)){
+		munmap((void*)data, info.st_size);
+		return FALSE;
+	}
+
+	const struct snapshot_header* header = (const void*)data;
+	const struct snapshot_class* classes = (const void*)(header + 1);
+	const struct snapshot_warehouse* record = (const void*)(classes + header->class_count);
+	const struct snapshot_split* splitRecord = (const void*)(record + header->warehouse_count);
+	const int32_t* recycled = (const void*)(splitRecord + header->split_count);
+	const char* names = data + info.st_size - header->name_bytes;
+
+	freeAllWarehouseSFList();
+	struct warehouse_split** splits = malloc(((size_t)header->split_count + 1) * sizeof(struct warehouse_split*));
+	for (uint32_t i = 0; i < header->split_count; i++){
+		struct warehouse_split* split = poolAlloc(&warehouseSplitPool);
+		split->halves[0] = NULL;
+		split->halves[1] = NULL;
+		split->parent = splitRecord[i].parent ? splits[(splitRecord[i].parent >> 1) - 1] : NULL;
+		split->side = splitRecord[i].parent & 1;
+		split->index = 0;
+		splits[i] = split;
+	}
+	for (uint32_t c = 0; c < header->class_count; c++){
+		struct warehouse_sf_list* sf = findSFList(classes[c].class_size);
+		if (!sf){
+			sf = createWarehouseSFList(classes[c].class_size);
+			insertWarehouseSFList(sf);
+		}
+		for (uint32_t i = 0; i < classes[c].member_count; i++, record++){
+			struct warehouse* warehouse = createWarehouse(record->id, record->size);
+			if (!warehouse){
+				// checkSnapshot() rules this out, but a database missing a warehouse would leave splits with a NULL half
+				printError("failed to restore %s, the database was cleared.\n", fileName);
+				free(splits);
+				freeAllWarehouseSFList();
+				munmap((void*)data, info.st_size);
+				return FALSE;
+			}
+			struct warehouse_list* wl = insertWarehouseHalf(warehouse, record->meta_info & 1,
+				record->split ? splits[(record->split >> 1) - 1] : NULL, record->split & 1);
+			if (record->meta_info & 2){
+				const char* name = names + record->art_name;
+				fillWarehouse(sf, wl,
+					createArtCollectionFromName(name, strlen(name), record->art_size, record->art_price));
+			}
+		}
+	}
+	free(splits);
+	restoreIDAllocator(header->next_fresh_id, recycled, header->recycled_count);
+	munmap((void*)data, info.st_size);
+	return TRUE;
+}
@@ -0,0 +1,560 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+#define VIEW_MAX_LEVEL 24
+
+/*
+ * view_node
+ * Entry of a sorted view for one occupied warehouse
+ * Entries are ordered by key, then by class size and sequence of the warehouse, which is the order printUnsorted() meets them in
+ * Occupied warehouses are never moved by splitting or coalescing, so that order holds for as long as the entry exists,
+ * and the class size and sequence are copied into the entry so comparing against it doesn't load the warehouse
+ */
+struct view_node {
+	int key;
+	int class_size;
+	unsigned long sequence;
+	struct warehouse_list* wl;
+	struct view_node* prev; // previous entry on the lowest level, NULL for the first, so a view can be walked backwards
+	int level;
+	struct view_node* next[]; // one link per level
+};
+
+/*
+ * sorted_view
+ * Skip list of the occupied warehouses of one visibility, ordered by size or by price
+ */
+struct sorted_view {
+	struct view_node* head; // sentinel with VIEW_MAX_LEVEL links
+	struct view_node* tail; // last entry, NULL if the view is empty
+	int level;
+	int count;
+};
+
+/*
+ * The four views, indexed by [bySize][private]
+ * They are off until "views on" (or art_db -v), since every add and delete pays for keeping them sorted
+ */
+static struct sorted_view sortedViews[2][2];
+static BOOLEAN viewsEnabled = FALSE;
+static uint32_t viewRandom = 2463534242u; // xorshift state for the levels of new entries
+
+/*
+ * viewKey()
+ * the key a warehouse is sorted by in a view
+ *
+ * Params:
+ * 	wl
+ * 	the occupied warehouse list member
+ *
+ * 	bySize
+ * 	TRUE for the size views, FALSE for the price views
+ *
+ * Return:
+ * 	size or price of its art collection
+ */
+static int viewKey(struct warehouse_list* wl, BOOLEAN bySize){
+	return bySize ? wl->warehouse->art_collection->size : wl->warehouse->art_collection->price;
+}
+
+/*
+ * viewBefore()
+ * compares an entry against a position in the order of the views
+ *
+ * Params:
+ * 	node
+ * 	entry of a view
+ *
+ * 	key, classSize, sequence
+ * 	the position: a key and the class size and sequence of a warehouse
+ *
+ * Return:
+ * 	TRUE if node goes before the position, FALSE otherwise
+ */
+static BOOLEAN viewBefore(struct view_node* node, int key, int classSize, unsigned long sequence){
+	if (node->key != key)
+		return node->key < key;
+	if (node->class_size != classSize)
+		return node->class_size < classSize;
+	return node->sequence < sequence;
+}
+
+/*
+ * randomLevel()
+ * draws the level of a new entry, each level above the first with a chance of 1 in 4
+ *
+ * Params:	void
+ *
+ * Return:
+ * 	level between 1 and VIEW_MAX_LEVEL
+ */
+static int randomLevel(){
+	int level = 1;
+	viewRandom ^= viewRandom << 13;
+	viewRandom ^= viewRandom >> 17;
+	viewRandom ^= viewRandom << 5;
+	uint32_t bits = viewRandom;
+	while (level < VIEW_MAX_LEVEL && !(bits & 3)){
+		level++;
+		bits >>= 2;
+	}
+	return level;
+}
+
+/*
+ * createViewNode()
+ * allocates an entry with the specified number of levels
+ *
+ * Params:
+ * 	key, wl
+ * 	the key and the warehouse of the entry, NULL for a sentinel
+ *
+ * 	level
+ * 	number of links of the entry
+ *
+ * Return:
+ * 	pointer to the newly malloc'd entry, with all links NULL
+ */
+static struct view_node* createViewNode(int key, struct warehouse_list* wl, int level){
+	struct view_node* output = malloc(sizeof(struct view_node) + level * sizeof(struct view_node*));
+	output->key = key;
+	output->class_size = wl ? wl->warehouse->size : 0;
+	output->sequence = wl ? wl->sequence : 0;
+	output->wl = wl;
+	output->prev = NULL;
+	output->level = level;
+	memset(output->next, 0, level * sizeof(struct view_node*));
+	return output;
+}
+
+/*
+ * viewInsert()
+ * inserts a warehouse into one view
+ *
+ * Params:
+ * 	view
+ * 	the view to be inserted into
+ *
+ * 	wl
+ * 	the occupied warehouse list member
+ *
+ * 	bySize
+ * 	TRUE if view is a size view, FALSE if it is a price view
+ *
+ * Return:
+ * 	void
+ */
+static void viewInsert(struct sorted_view* view, struct warehouse_list* wl, BOOLEAN bySize){
+	struct view_node* update[VIEW_MAX_LEVEL];
+	struct view_node* cursor = view->head;
+	int key = viewKey(wl, bySize);
+	int classSize = wl->warehouse->size;
+	int i;
+	for (i=view->level-1; i>=0; i--){
+		while (cursor->next[i] && viewBefore(cursor->next[i], key, classSize, wl->sequence))
+			cursor = cursor->next[i];
+		update[i] = cursor;
+	}
+	int level = randomLevel();
+	for (i=view->level; i<level; i++)
+		update[i] = view->head;
+	if (level > view->level)
+		view->level = level;
+	struct view_node* node = createViewNode(key, wl, level);
+	for (i=0; i<level; i++){
+		node->next[i] = update[i]->next[i];
+		update[i]->next[i] = node;
+	}
+	node->prev = (update[0] == view->head) ? NULL : update[0];
+	if (node->next[0])
+		node->next[0]->prev = node;
+	else
+		view->tail = node;
+	view->count++;
+}
+
+/*
+ * viewRemove()
+ * removes a warehouse from one view, if it is in it
+ *
+ * Params:
+ * 	view
+ * 	the view to be removed from
+ *
+ * 	wl
+ * 	the occupied warehouse list member, whose art collection is still attached
+ *
+ * 	bySize
+ * 	TRUE if view is a size view, FALSE if it is a price view
+ *
+ * Return:
+ * 	void
+ */
+static void viewRemove(struct sorted_view* view, struct warehouse_list* wl, BOOLEAN bySize){
+	struct view_node* update[VIEW_MAX_LEVEL];
+	struct view_node* cursor = view->head;
+	int key = viewKey(wl, bySize);
+	int classSize = wl->warehouse->size;
+	int i;
+	for (i=view->level-1; i>=0; i--){
+		while (cursor->next[i] && viewBefore(cursor->next[i], key, classSize, wl->sequence))
+			cursor = cursor->next[i];
+		update[i] = cursor;
+	}
+	struct view_node* node = cursor->next[0];
+	if (!node || node->wl != wl)
+		return;
+	for (i=0; i<node->level; i++)
+		update[i]->next[i] = node->next[i];
+	if (node->next[0])
+		node->next[0]->prev = node->prev;
+	else
+		view->tail = node->prev;
+	while (view->level > 1 && !view->head->next[view->level-1])
+		view->level--;
+	free(node);
+	view->count--;
+}
+
+/*
+ * clearView()
+ * frees every entry of a view, keeping (or making) its sentinel
+ *
+ * Params:
+ * 	view
+ * 	the view to be emptied
+ *
+ * Return:
+ * 	void
+ */
+static void clearView(struct sorted_view* view){
+	struct view_node* cursor = view->head ? view->head->next[0] : NULL;
+	struct view_node* temp;
+	while (cursor){
+		temp = cursor;
+		cursor = cursor->next[0];
+		free(temp);
+	}
+	if (!view->head)
+		view->head = createViewNode(0, NULL, VIEW_MAX_LEVEL);
+	memset(view->head->next, 0, VIEW_MAX_LEVEL * sizeof(struct view_node*));
+	view->tail = NULL;
+	view->level = 1;
+	view->count = 0;
+}
+
+/*
+ * initSortedViews()
+ * makes the sentinels of the views the first time they are needed
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+static void initSortedViews(){
+	if (!sortedViews[FALSE][FALSE].head)
+		clearSortedViews();
+}
+
+/*
+ * addToSortedViews()
+ * adds a warehouse that was just filled to the size view and the price view of its visibility
+ *
+ * Params:
+ * 	wl
+ * 	the occupied warehouse list member
+ *
+ * Return:
+ * 	void
+ */
+void addToSortedViews(struct warehouse_list* wl){
+	if (!viewsEnabled)
+		return;
+	int private = wl->meta_info & 1;
+	initSortedViews();
+	viewInsert(&sortedViews[TRUE][private], wl, TRUE);
+	viewInsert(&sortedViews[FALSE][private], wl, FALSE);
+}
+
+/*
+ * removeFromSortedViews()
+ * removes a warehouse that is being emptied from the views
+ *
+ * Params:
+ * 	wl
+ * 	the occupied warehouse list member, whose art collection is still attached
+ *
+ * Return:
+ * 	void
+ */
+void removeFromSortedViews(struct warehouse_list* wl){
+	int private = wl->meta_info & 1;
+	if (!viewsEnabled || !sortedViews[TRUE][private].head)
+		return;
+	viewRemove(&sortedViews[TRUE][private], wl, TRUE);
+	viewRemove(&sortedViews[FALSE][private], wl, FALSE);
+}
+
+/*
+ * clearSortedViews()
+ * empties the views (for example when the database is freed), leaving them enabled or disabled as they were
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void clearSortedViews(){
+	int bySize, private;
+	for (bySize=0; bySize<2; bySize++)
+		for (private=0; private<2; private++)
+			clearView(&sortedViews[bySize][private]);
+}
+
+/*
+ * freeSortedViews()
+ * frees the views, including their sentinels
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+static void freeSortedViews(){
+	int bySize, private;
+	for (bySize=0; bySize<2; bySize++){
+		for (private=0; private<2; private++){
+			if (sortedViews[bySize][private].head){
+				clearView(&sortedViews[bySize][private]);
+				free(sortedViews[bySize][private].head);
+				sortedViews[bySize][private].head = NULL;
+			}
+		}
+	}
+}
+
+/*
+ * setSortedViews()
+ * turns the views on, building them from every occupied warehouse of the database, or off, freeing them
+ *
+ * Params:
+ * 	enable
+ * 	TRUE to keep the views, FALSE to drop them and sort on every print instead
+ *
+ * Return:
+ * 	void
+ */
+void setSortedViews(BOOLEAN enable){
+	freeSortedViews();
+	viewsEnabled = enable;
+	if (!enable)
+		return;
+	clearSortedViews();
+	struct warehouse_sf_list* sf_cursor = sf_head;
+	while (sf_cursor){
+		uint32_t word;
+		for (word=0; word<(sf_cursor->slot_count + 63) / 64; word++){
+			uint64_t bits = occupiedSlots(sf_cursor, word, TRUE, FALSE);
+			while (bits){
+				addToSortedViews(sf_cursor->slots[(word << 6) + __builtin_ctzll(bits)]);
+				bits &= bits - 1;
+			}
+		}
+		sf_cursor = sf_cursor->sf_next_warehouse;
+	}
+}
+
+/*
+ * sortedViewsEnabled()
+ *
+ * Params:	void
+ *
+ * Return:
+ * 	TRUE if the views are kept up to date, FALSE otherwise
+ */
+BOOLEAN sortedViewsEnabled(){
+	return viewsEnabled;
+}
+
+/*
+ * nodeBefore()
+ * compares two entries in the order of the views
+ *
+ * Params:
+ * 	node, other
+ * 	entries of views with the same key
+ *
+ * Return:
+ * 	TRUE if node goes before other, FALSE otherwise
+ */
+static BOOLEAN nodeBefore(struct view_node* node, struct view_node* other){
+	return viewBefore(node, other->key, other->class_size, other->sequence);
+}
+
+/*
+ * viewSeek()
+ * finds the first entry of a view whose key is at least the specified key, going down the levels of the skip list
+ *
+ * Params:
+ * 	view
+ * 	the view searched
+ *
+ * 	key
+ * 	the lowest key wanted
+ *
+ * Return:
+ * 	the entry, NULL if every key of the view is lower
+ */
+static struct view_node* viewSeek(struct sorted_view* view, int key){
+	struct view_node* cursor = view->head;
+	int i;
+	for (i=view->level-1; i>=0; i--){
+		while (cursor->next[i] && cursor->next[i]->key < key){
+			STATS_COUNT(STAT_NODES_TRAVERSED, 1);
+			cursor = cursor->next[i];
+		}
+	}
+	return cursor->next[0];
+}
+
+/*
+ * printViewEntries()
+ * prints the art collections of the entries met walking from a public and a private entry at once, followed by their total price
+ * the two walks are merged in the order of the views, backwards if descending
+ *
+ * Params:
+ * 	publicCursor, privateCursor
+ * 	entries the walks start from, NULL for no walk
+ *
+ * 	descending
+ * 	TRUE to walk towards the lowest keys, FALSE towards the highest
+ *
+ * 	high
+ * 	the walk stops at the first key above it (INT_MAX to go to the end)
+ *
+ * 	limit
+ * 	most art collections printed, negative for no limit
+ *
+ * 	totaled
+ * 	TRUE to end with the total price, FALSE to end with 0 as the sorted prints always have (see printSorted())
+ *
+ * Return:
+ * 	void
+ */
+static void printViewEntries(struct view_node* publicCursor, struct view_node* privateCursor, BOOLEAN descending, int high, long limit, BOOLEAN totaled){
+	struct view_node* next;
+	int total = 0;
+	if (publicCursor && publicCursor->key > high)
+		publicCursor = NULL;
+	if (privateCursor && privateCursor->key > high)
+		privateCursor = NULL;
+	while ((publicCursor || privateCursor) && limit--){
+		if (!privateCursor || (publicCursor && nodeBefore(publicCursor, privateCursor) != descending)){
+			next = publicCursor;
+			publicCursor = descending ? publicCursor->prev : publicCursor->next[0];
+			if (publicCursor && publicCursor->key > high)
+				publicCursor = NULL;
+		}
+		else{
+			next = privateCursor;
+			privateCursor = descending ? privateCursor->prev : privateCursor->next[0];
+			if (privateCursor && privateCursor->key > high)
+				privateCursor = NULL;
+		}
+		STATS_COUNT(STAT_NODES_TRAVERSED, 1);
+		printArtCollection(next->wl->warehouse->art_collection);
+		total += next->wl->warehouse->art_collection->price;
+	}
+	outputInt(totaled ? total : 0);
+	outputBytes("\n", 1);
+}
+
+/*
+ * printSortedView()
+ * prints the art collections of the database to stdout in order of size or price by walking the views, followed by 0 like printSorted()
+ * printing all of them merges the public and private views as it walks them
+ *
+ * Params:
+ * 	all
+ * 	TRUE if all art collections are to be printed,  FALSE otherwise
+ *
+ * 	private
+ * 	TRUE if art collections in private warehouses are to be printed
+ * 	FALSE if art collections in public warehouses are to be printed
+ * 	overridden by all param
+ *
+ * 	bySize
+ * 	TRUE to print in order of size, FALSE in order of price
+ *
+ * Return:
+ * 	void
+ */
+void printSortedView(BOOLEAN all, BOOLEAN private, BOOLEAN bySize){
+	int key = bySize ? TRUE : FALSE;
+	initSortedViews();
+	printViewEntries((all || !private) ? sortedViews[key][FALSE].head->next[0] : NULL,
+		(all || private) ? sortedViews[key][TRUE].head->next[0] : NULL, FALSE, INT_MAX, -1, FALSE);
+}
+
+/*
+ * printRange()
+ * prints the art collections whose size or price is between two bounds, lowest first, followed by their total price
+ * each view is entered at the lower bound through its upper levels, so only the collections printed are walked
+ *
+ * Params:
+ * 	all, private
+ * 	which art collections are printed, as for printSortedView()
+ *
+ * 	bySize
+ * 	TRUE to bound the size, FALSE the price
+ *
+ * 	low, high
+ * 	the bounds, both included
+ *
+ * Return:
+ * 	void
+ */
+void printRange(BOOLEAN all, BOOLEAN private, BOOLEAN bySize, int low, int high){
+	if (!viewsEnabled){
+		printError("range needs the sorted views, turn them on with \"views on\".\n");
+		return;
+	}
+	int key = bySize ? TRUE : FALSE;
+	initSortedViews();
+	printViewEntries((all || !private) ? viewSeek(&sortedViews[key][FALSE], low) : NULL,
+		(all || private) ? viewSeek(&sortedViews[key][TRUE], low) : NULL, FALSE, high, -1, TRUE);
+}
+
+/*
+ * printTop()
+ * prints the art collections of highest size or price, highest first, followed by their total price
+ * the views are walked backwards from their last entries
+ *
+ * Params:
+ * 	all, private
+ * 	which art collections are printed, as for printSortedView()
+ *
+ * 	bySize
+ * 	TRUE for the largest collections, FALSE for the most expensive
+ *
+ * 	count
+ * 	most art collections printed
+ *
+ * Return:
+ * 	void
+ */
+void printTop(BOOLEAN all, BOOLEAN private, BOOLEAN bySize, int count){
+	if (!viewsEnabled){
+		printError("top needs the sorted views, turn them on with \"views on\".\n");
+		return;
+	}
+	int key = bySize ? TRUE : FALSE;
+	initSortedViews();
+	printViewEntries((all || !private) ? sortedViews[key][FALSE].tail : NULL,
+		(all || private) ? sortedViews[key][TRUE].tail : NULL, TRUE, INT_MAX, (count > 0) ? count : 0, TRUE);
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "warehouse.h"
+#define BOOLEAN char
+#define TRUE 1
+#define FALSE 0
+
+/*
+ * Statistics of a session, gathered by the STATS_ macros of warehouse.h
+ * Without ART_DB_STATS the macros are empty and only the stats command is left (to report it)
+ * With it, they cost a test of statsEnabled until "stats on"
+ */
+BOOLEAN statsEnabled = FALSE;
+
+struct timed_stat {
+	const char* name;
+	unsigned long calls;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+};
+
+static struct timed_stat timedStats[STAT_TIMED_COUNT] = {
+	{ "command load", 0, 0, 0 },
+	{ "command save", 0, 0, 0 },
+	{ "command add", 0, 0, 0 },
+	{ "command delete", 0, 0, 0 },
+	{ "command find", 0, 0, 0 },
+	{ "command print", 0, 0, 0 },
+	{ "command utilization", 0, 0, 0 },
+	{ "command other", 0, 0, 0 },
+	{ "insertArtCollection", 0, 0, 0 },
+	{ "coalesce", 0, 0, 0 },
+	{ "nextGoodID", 0, 0, 0 },
+	{ "badID", 0, 0, 0 },
+	{ "printUnsorted", 0, 0, 0 },
+	{ "printBySize", 0, 0, 0 },
+	{ "printByPrice", 0, 0, 0 },
+};
+
+unsigned long long statsCounters[STAT_COUNTER_COUNT];
+
+/*
+ * statsRecord()
+ * adds the time since start to a timed statistic
+ *
+ * Params:
+ * 	stat
+ * 	the statistic timed
+ *
+ * 	start
+ * 	when the timed call started
+ *
+ * Return:
+ * 	void
+ */
+void statsRecord(int stat, struct timespec* start){
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	unsigned long long elapsed = (end.tv_sec - start->tv_sec) * 1000000000ull + end.tv_nsec - start->tv_nsec;
+	timedStats[stat].calls++;
+	timedStats[stat].total_ns += elapsed;
+	if (elapsed > timedStats[stat].max_ns)
+		timedStats[stat].max_ns = elapsed;
+}
+
+/*
+ * statsCommand()
+ * picks the timed statistic of a shell command
+ *
+ * Params:
+ * 	command
+ * 	the first argument of the command
+ *
+ * Return:
+ * 	the statistic of the command
+ */
+int statsCommand(char* command){
+	if (!strcmp(command, "load"))
+		return STAT_COMMAND_LOAD;
+	if (!strcmp(command, "save") || !strcmp(command, "compact"))
+		return STAT_COMMAND_SAVE;
+	if (!strcmp(command, "add"))
+		return STAT_COMMAND_ADD;
+	if (!strcmp(command, "delete"))
+		return STAT_COMMAND_DELETE;
+	if (!strcmp(command, "find"))
+		return STAT_COMMAND_FIND;
+	if (!strcmp(command, "print") || !strcmp(command, "printall") || !strcmp(command, "range") || !strcmp(command, "top"))
+		return STAT_COMMAND_PRINT;
+	if (!strcmp(command, "utilization"))
+		return STAT_COMMAND_UTILIZATION;
+	return STAT_COMMAND_OTHER;
+}
+
+/*
+ * setStats()
+ * starts or stops gathering statistics
+ *
+ * Params:
+ * 	enable
+ * 	TRUE to start, FALSE to stop
+ *
+ * Return:
+ * 	void
+ */
+void setStats(BOOLEAN enable){
+#ifndef ART_DB_STATS
+	(void)enable;
+	printError("statistics were not compiled in, build with -DART_DB_STATS (make STATS=1).\n");
+#else
+	statsEnabled = enable;
+#endif
+}
+
+/*
+ * resetStats()
+ * zeroes every statistic
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void resetStats(){
+	int i;
+	for (i=0; i<STAT_TIMED_COUNT; i++){
+		timedStats[i].calls = 0;
+		timedStats[i].total_ns = 0;
+		timedStats[i].max_ns = 0;
+	}
+	memset(statsCounters, 0, sizeof(statsCounters));
+}
+
+/*
+ * printStats()
+ * prints to stdout the calls, total and maximum time of every timed statistic that was called, then the counters
+ *
+ * Params:	void
+ *
+ * Return:	void
+ */
+void printStats(){
+#ifndef ART_DB_STATS
+	printError("statistics were not compiled in, build with -DART_DB_STATS (make STATS=1).\n");
+#else
+	static const char* counterNames[STAT_COUNTER_COUNT] = { "splits", "warehouses coalesced", "nodes traversed" };
+	int i;
+	outputFormat("stats are %s\n", statsEnabled ? "on" : "off");
+	outputFormat("%-24s%12s%14s%12s%12s\n", "", "calls", "total ms", "mean us", "max us");
+	for (i=0; i<STAT_TIMED_COUNT; i++){
+		if (!timedStats[i].calls)
+			continue;
+		outputFormat("%-24s%12lu%14.3f%12.3f%12.3f\n", timedStats[i].name, timedStats[i].calls, timedStats[i].total_ns / 1e6,
+			timedStats[i].total_ns / 1e3 / timedStats[i].calls, timedStats[i].max_ns / 1e3);
+	}
+	for (i=0; i<STAT_COUNTER_COUNT; i++)
+		outputFormat("%-24s%12llu\n", counterNames[i], statsCounters[i]);
+#endif
+}
@@ -3,6 +3,9 @@
 #define BOOLEAN char
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <time.h>
 
 struct art_collection {
     char* name;
@@ -25,42 +28,210 @@ structure of meta_info
     uint64_t is_private:1; // Defines ownership of the warehouse (1 is private and 0 is public)
 */
 
+struct warehouse_split;
+
 struct warehouse_list {
     uint64_t meta_info; // Meta information about warehouse node; it is mimicking memory block header
     struct warehouse* warehouse; // Useful information about actual warehouse; think of payload
-    struct warehouse_list* next_warehouse;
+    uint32_t slot; // position in the slots of its class (see size_directory.c)
+    uint32_t free_root; // position + 1 in the free root heap of defrag.c, 0 while occupied or with a split record
+    struct warehouse_list* next_same_name; // links of the name index entry of its art collection, only used while occupied
+    struct warehouse_list* prev_same_name;
+    unsigned long sequence; // stamped when appended, so the members of a class are in increasing order of it
+    struct warehouse_split* split; // record of the split that made this warehouse, NULL for a loaded (root) warehouse
+};
+
+/* Record of a warehouse split in two by insertArtCollection(), kept until the two halves are coalesced back into it
+ * A half that was itself split is NULL in halves, its own split record pointing back here through parent */
+struct warehouse_split {
+    struct warehouse_list* halves[2]; // the first half kept the ID of the split warehouse
+    struct warehouse_split* parent; // split record of the split warehouse, NULL if it was a root warehouse
+    int side; // which half of parent the split warehouse was
+    uint32_t index; // scratch of saveSnapshot()
 };
 
 struct warehouse_sf_list {
     // `class_size' represents warehouse sizes that correspond to the list this node points to
     int class_size;
-    struct warehouse_list* warehouse_list_head;
     struct warehouse_sf_list* sf_next_warehouse;
+    size_t directory_index; // position of this class in the size directory (see size_directory.c)
+    // the members of the class, in the order they were appended, as arrays indexed by slot (see size_directory.c)
+    struct warehouse_list** slots; // NULL in the holes left by unlinked members
+    int32_t* ids; // ID of the warehouse of each member
+    struct art_collection** arts; // art collection of each member, NULL while unoccupied
+    uint64_t* live_bits; // bitmaps of a bit per slot: set while it holds a member,
+    uint64_t* free_bits; // while that member is unoccupied,
+    uint64_t* private_bits; // and if that member is private
+    uint32_t slot_count; // slots used so far, holes included
+    uint32_t slot_capacity; // multiple of 64
+    uint32_t holes;
+    uint32_t free_count;
+    uint32_t first_free_word; // no word of free before it has a bit set
+};
+
+extern struct warehouse_sf_list* sf_head; // defined in linked_list.c
+
+/* Slab pool of fixed size objects (see pool.c); freed objects are kept on free_list for reuse */
+struct pool {
+    size_t object_size;
+    void* free_list;
+    struct slab* slabs;
+    char* next; // next unused byte of the newest slab
+    char* end;
 };
 
-struct warehouse_sf_list* sf_head;
+extern struct pool warehousePool; // defined in pool.c
+extern struct pool warehouseListPool;
+extern struct pool warehouseSFListPool;
+extern struct pool artCollectionPool;
+extern struct pool warehouseSplitPool;
+
+/* Statistics (see stats.c): the timed calls and the counters, and the macros gathering them
+ * Built without ART_DB_STATS the macros are empty, otherwise they only do something after "stats on" */
+enum stat_timed {
+	STAT_COMMAND_LOAD, STAT_COMMAND_SAVE, STAT_COMMAND_ADD, STAT_COMMAND_DELETE, STAT_COMMAND_FIND, STAT_COMMAND_PRINT,
+	STAT_COMMAND_UTILIZATION, STAT_COMMAND_OTHER,
+	STAT_INSERT_ART_COLLECTION, STAT_COALESCE, STAT_NEXT_GOOD_ID, STAT_BAD_ID, STAT_PRINT_UNSORTED, STAT_PRINT_BY_SIZE, STAT_PRINT_BY_PRICE,
+	STAT_TIMED_COUNT
+};
+
+enum stat_counter { STAT_SPLITS, STAT_COALESCED, STAT_NODES_TRAVERSED, STAT_COUNTER_COUNT };
+
+extern BOOLEAN statsEnabled; // defined in stats.c
+extern unsigned long long statsCounters[STAT_COUNTER_COUNT];
+
+#ifdef ART_DB_STATS
+#define STATS_START(timer) struct timespec timer; BOOLEAN timer##Timed = statsEnabled && !clock_gettime(CLOCK_MONOTONIC, &timer)
+#define STATS_STOP(timer, stat) do { if (timer##Timed) statsRecord(stat, &timer); } while (0)
+#define STATS_COUNT(counter, amount) do { if (statsEnabled) statsCounters[counter] += (amount); } while (0)
+#else
+#define STATS_START(timer)
+#define STATS_STOP(timer, stat) do { } while (0)
+#define STATS_COUNT(counter, amount) do { } while (0)
+#endif
 
 // Declarations of functions used throughout the program
 	// Defined in linked_list.c
 		struct warehouse* createWarehouse(int id, int size);
 		void insertWarehouse(struct warehouse* warehouse, BOOLEAN private);
-		void loadWarehouseFile(FILE* warehouseFile);
+		struct warehouse_list* insertWarehouseHalf(struct warehouse* warehouse, BOOLEAN private, struct warehouse_split* split, int side);
+		struct warehouse_sf_list* createWarehouseSFList(int class_size);
+		void insertWarehouseSFList(struct warehouse_sf_list* toBeInserted);
 		
-		void emptyWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl_prev_prev, struct warehouse_list* wl_prev, struct warehouse_list* wl);
+		void unlinkWarehouseList(struct warehouse_sf_list* sf, struct warehouse_list* wl);
+		struct warehouse_split* splitWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl, int firstSize);
+		void fillWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl, struct art_collection* art_collection);
+		void emptyWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl);
 		void removeWarehouse(int id);
 		void freeWarehouseList(struct warehouse_list* wl);
 		void freeAllWarehouseSFList();
-		
+
+		void getUtilization(BOOLEAN all, BOOLEAN private, double* occupied, double* filled);
+		void printUtilization(BOOLEAN all, BOOLEAN private);
+
+	// Defined in id_index.c
+		void indexWarehouse(struct warehouse_list* wl);
+		void unindexWarehouse(int id);
+		struct warehouse_list* findWarehouse(int id);
+		void freeIDIndex();
+
 		int nextGoodID();
+		void releaseID(int id);
+		void resetIDAllocator();
+		int getIDAllocator(const int** recycled, size_t* recycledCount);
+		BOOLEAN validIDAllocator(int nextFresh, const int* recycled, size_t recycledCount);
+		void restoreIDAllocator(int nextFresh, const int* recycled, size_t recycledCount);
 
-		void printUtilization();
+	// Defined in size_directory.c
+		struct warehouse_sf_list* findSFList(int class_size);
+		struct warehouse_sf_list* addSFList(struct warehouse_sf_list* sf);
+		void addClassMember(struct warehouse_sf_list* sf, struct warehouse_list* wl);
+		void removeClassMember(struct warehouse_sf_list* sf, struct warehouse_list* wl);
+		struct warehouse_list* previousClassMember(struct warehouse_sf_list* sf, struct warehouse_list* wl);
+		struct warehouse_list* nextClassMember(struct warehouse_sf_list* sf, struct warehouse_list* wl);
+		void pushFreeWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl);
+		void removeFreeWarehouse(struct warehouse_sf_list* sf, struct warehouse_list* wl);
+		struct warehouse_list* findFreeWarehouse(int size, struct warehouse_sf_list** sf);
+		uint64_t occupiedSlots(struct warehouse_sf_list* sf, uint32_t word, BOOLEAN all, BOOLEAN private);
+		long countClassMembers(struct warehouse_sf_list* sf, BOOLEAN private, BOOLEAN occupied);
+		void freeSizeDirectory();
 
-	// Defined in art_controller.c
+	// Defined in name_index.c
+		void indexArtCollection(struct warehouse_list* wl);
+		void unindexArtCollection(struct warehouse_list* wl);
+		struct warehouse_list** gatherArtCollections(char* name, int* count);
+		void freeNameIndex();
+
+	// Defined in loader.c
+		void loadWarehouseFile(FILE* warehouseFile);
 		void loadArtFile(FILE* artFile);
-		
+		void loadArtFileBulk(FILE* artFile, BOOLEAN compare);
+		void setLoaderThreads(int threads);
+
+	// Defined in defrag.c
+		void addFreeRoot(struct warehouse_list* wl);
+		void removeFreeRoot(struct warehouse_list* wl);
+		void clearFreeRoots();
+		void setDefragBudget(int budget);
+		void defragDemand(int size);
+		void defragStep();
+		void defragment();
+
+	// Defined in snapshot.c
+		BOOLEAN saveSnapshot(char* fileName);
+		BOOLEAN loadSnapshot(char* fileName);
+
+	// Defined in journal.c
+		BOOLEAN openJournal(char* fileName);
+		BOOLEAN journalOpen();
+		void journalCommand(char** args);
+		void syncJournal();
+		void journalTick();
+		BOOLEAN compactJournal();
+		void closeJournal();
+
+	// Defined in output.c
+		void outputBytes(const char* data, size_t length);
+		void outputString(const char* string);
+		void outputInt(int value);
+		void outputFormat(const char* format, ...);
+		void outputError(const char* format, va_list arguments);
+		void flushOutput();
+		BOOLEAN redirectOutput(char* fileName);
+		void endRedirect();
+
+	// Defined in stats.c
+		void statsRecord(int stat, struct timespec* start);
+		int statsCommand(char* command);
+		void setStats(BOOLEAN enable);
+		void resetStats();
+		void printStats();
+
+	// Defined in pool.c
+		void* poolAlloc(struct pool* pool);
+		void poolFree(struct pool* pool, void* object);
+		void poolRelease(struct pool* pool);
+		char* internLowercase(const char* string, size_t length);
+		void releaseStringTable();
+
+	// Defined in sorted_view.c
+		void addToSortedViews(struct warehouse_list* wl);
+		void removeFromSortedViews(struct warehouse_list* wl);
+		void clearSortedViews();
+		void setSortedViews(BOOLEAN enable);
+		BOOLEAN sortedViewsEnabled();
+		void printSortedView(BOOLEAN all, BOOLEAN private, BOOLEAN bySize);
+		void printRange(BOOLEAN all, BOOLEAN private, BOOLEAN bySize, int low, int high);
+		void printTop(BOOLEAN all, BOOLEAN private, BOOLEAN bySize, int count);
+
+	// Defined in art_controller.c
 		struct art_collection* createArtCollection(char* name, int size, int price);
-		void insertArtCollection(struct art_collection* art_collection);
-		void removeArtCollection(char* name, int count);
+		struct art_collection* createArtCollectionFromName(const char* name, size_t length, int size, int price);
+		void freeArtCollection(struct art_collection* art_collection);
+		BOOLEAN insertArtCollection(struct art_collection* art_collection);
+		int insertArtCollectionRun(struct art_collection** art_collections, int count);
+		void removeArtCollection(char* name);
+		void findArtCollection(char* name);
 		
 		void printArtCollection(struct art_collection* artC);
 		void printUnsorted(BOOLEAN all, BOOLEAN private);
@@ -69,7 +240,14 @@ struct warehouse_sf_list* sf_head;
 
 	// Defined in shell.c
 		void shell_loop(int maxArgs);
+		BOOLEAN runBatch(FILE* script, int maxArgs, BOOLEAN stopOnError);
+		int splitCommand(char* commandLine, int maxArgs, char** output);
+		BOOLEAN quotedArgument(char* arg);
 		char** commandSplitter(char* commandLine, int maxArgs);
+		void printError(const char* format, ...);
+		int errorsPrinted();
+		int silenceOutput();
+		void restoreOutput(int saved);
 		BOOLEAN executeCommand(char** args); //not actually defined, just originates (actually defined in main.c)
 
 #endif /* WAREHOUSE_H */